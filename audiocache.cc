@@ -0,0 +1,177 @@
+#include "audiocache.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+  constexpr size_t INITIAL_CAPACITY = 1024;
+  // Rows written before version 1 may be keyed by audio ID instead of example ID
+  constexpr int SCHEMA_VERSION = 1;
+}
+
+namespace Bot
+{
+  AudioCache::Table::Table(size_t capacity)
+      : mask(capacity - 1), slots(std::make_unique<Slot[]>(capacity))
+  {
+  }
+
+  AudioCache::AudioCache(SQLite::Database &db)
+      : statements_(std::make_unique<StatementPool>(db))
+  {
+    tables_.push_back(std::make_unique<Table>(INITIAL_CAPACITY));
+    table_.store(tables_.back().get(), std::memory_order_release);
+
+    try
+    {
+      if (db.execAndGet("PRAGMA user_version").getInt() < SCHEMA_VERSION)
+      {
+        // There is no telling which keys are wrong, the clips are uploaded again on demand
+        db.exec("DELETE FROM AudioCache");
+        db.exec("PRAGMA user_version = " + std::to_string(SCHEMA_VERSION));
+        LOG_INFO("Audio cache cleared, its rows predate example ID keys\n");
+      }
+
+      std::lock_guard<std::mutex> lock(writeMutex_);
+      SQLite::Statement query(db, "SELECT TatoebaID, AudioID FROM AudioCache");
+      while (query.executeStep())
+      {
+        insert(static_cast<uint32_t>(query.getColumn(0).getInt64()), query.getColumn(1).getText());
+      }
+      LOG_INFO("Loaded {} cached audio clips\n", size());
+    }
+    catch (const std::exception &e)
+    {
+      LOG_EXCEPTION("Audio Cache exception", e);
+    }
+  }
+
+  size_t AudioCache::slotFor(uint32_t key, size_t mask)
+  {
+    // murmur3 finalizer, example IDs are dense and sequential
+    uint32_t x = key;
+    x = (x ^ (x >> 16)) * 0x85ebca6bU;
+    x = (x ^ (x >> 13)) * 0xc2b2ae35U;
+    return (x ^ (x >> 16)) & mask;
+  }
+
+  void AudioCache::place(Table &table, uint32_t key, const std::string *value)
+  {
+    for (size_t slot = slotFor(key, table.mask);; slot = (slot + 1) & table.mask)
+    {
+      if (!table.slots[slot].key.load(std::memory_order_relaxed))
+      {
+        // The value goes first, a reader that sees the key sees its value
+        table.slots[slot].value.store(value, std::memory_order_relaxed);
+        table.slots[slot].key.store(key, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  const std::string *AudioCache::lookup(uint32_t exampleID) const
+  {
+    if (!exampleID)
+    {
+      return nullptr;
+    }
+
+    const Table &table = *table_.load(std::memory_order_acquire);
+    for (size_t slot = slotFor(exampleID, table.mask);; slot = (slot + 1) & table.mask)
+    {
+      const uint32_t current = table.slots[slot].key.load(std::memory_order_acquire);
+      if (current == exampleID)
+      {
+        return table.slots[slot].value.load(std::memory_order_relaxed);
+      }
+      if (!current)
+      {
+        return nullptr;
+      }
+    }
+  }
+
+  std::string AudioCache::find(uint32_t exampleID) const
+  {
+    if (const std::string *fileID = lookup(exampleID))
+    {
+      hits_++;
+      return *fileID;
+    }
+    misses_++;
+    return std::string();
+  }
+
+  bool AudioCache::insert(uint32_t exampleID, const std::string &fileID)
+  {
+    if (!exampleID || fileID.empty() || lookup(exampleID))
+    {
+      return false;
+    }
+
+    Table *table = table_.load(std::memory_order_relaxed);
+    const size_t capacity = table->mask + 1;
+    if ((size_ + 1) * 2 > capacity)
+    {
+      auto grown = std::make_unique<Table>(capacity * 2);
+      for (size_t i = 0; i < capacity; ++i)
+      {
+        if (const uint32_t key = table->slots[i].key.load(std::memory_order_relaxed))
+        {
+          place(*grown, key, table->slots[i].value.load(std::memory_order_relaxed));
+        }
+      }
+      table = grown.get();
+      tables_.push_back(std::move(grown));
+    }
+
+    values_.push_back(std::make_unique<const std::string>(fileID));
+    place(*table, exampleID, values_.back().get());
+    table_.store(table, std::memory_order_release);
+    size_++;
+    return true;
+  }
+
+  bool AudioCache::store(uint32_t exampleID, const std::string &fileID)
+  {
+    if (!exampleID || fileID.empty())
+    {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    if (!insert(exampleID, fileID))
+    {
+      // First upload wins, the table already has it
+      return true;
+    }
+
+    try
+    {
+      auto stmt = statements_->acquire("INSERT OR IGNORE INTO AudioCache (AudioID, TatoebaID) VALUES (?, ?);");
+      LOG_DEBUG("Storing audio cache: {} {}\n", fileID, exampleID);
+      stmt->bind(1, fileID);
+      stmt->bind(2, exampleID);
+      stmt->exec();
+    }
+    catch (const std::exception &e)
+    {
+      failedWrites_++;
+      LOG_EXCEPTION("Audio Cache exception", e);
+      return false;
+    }
+    return true;
+  }
+
+  AudioCache::Stats AudioCache::stats() const
+  {
+    Stats result;
+    result.entries = size();
+    result.hits = hits_;
+    result.misses = misses_;
+    result.failedWrites = failedWrites_;
+    result.statements = statements_->stats();
+    return result;
+  }
+}
\ No newline at end of file
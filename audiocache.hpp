@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <SQLiteCpp/SQLiteCpp.h>
+#include "statementpool.hpp"
+
+namespace Bot
+{
+  // Telegram file IDs of uploaded listening clips by Tatoeba example ID. The
+  // AudioCache table is read once at startup and lookups never touch SQLite:
+  // they probe an open-addressing table of atomics without locking. Stores
+  // are serialized, write through to the table, and never replace an entry,
+  // so a published file ID stays valid until the cache is destroyed.
+  class AudioCache
+  {
+  public:
+    using Ptr = std::unique_ptr<AudioCache>;
+
+    struct Stats
+    {
+      size_t entries = 0;
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t failedWrites = 0;
+      StatementPool::Stats statements;
+    };
+
+    // The database must outlive the cache
+    explicit AudioCache(SQLite::Database &db);
+    AudioCache(const AudioCache &) = delete;
+    AudioCache &operator=(const AudioCache &) = delete;
+
+    // Empty if the clip hasn't been uploaded yet, counted as a hit or a miss
+    std::string find(uint32_t exampleID) const;
+    // Same without touching the hit/miss counters
+    bool contains(uint32_t exampleID) const { return lookup(exampleID); }
+    // Returns false if the row couldn't be written, the entry is served from memory regardless
+    bool store(uint32_t exampleID, const std::string &fileID);
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+    Stats stats() const;
+
+  private:
+    struct Slot
+    {
+      std::atomic<uint32_t> key = 0;
+      std::atomic<const std::string *> value = nullptr;
+    };
+
+    struct Table
+    {
+      Table(size_t capacity);
+
+      const size_t mask;
+      std::unique_ptr<Slot[]> slots;
+    };
+
+    static size_t slotFor(uint32_t key, size_t mask);
+    static void place(Table &table, uint32_t key, const std::string *value);
+    const std::string *lookup(uint32_t exampleID) const;
+    // Called with writeMutex_ held
+    bool insert(uint32_t exampleID, const std::string &fileID);
+
+    StatementPool::Ptr statements_;
+    std::atomic<Table *> table_;
+    std::atomic<size_t> size_ = 0;
+    std::mutex writeMutex_;
+    std::vector<std::unique_ptr<Table>> tables_;
+    std::vector<std::unique_ptr<const std::string>> values_;
+
+    mutable std::atomic<uint64_t> hits_ = 0;
+    mutable std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> failedWrites_ = 0;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "audioprewarmer.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  // How often a pending upload is checked while waiting for it
+  constexpr std::chrono::milliseconds UPLOAD_POLL(100);
+}
+
+namespace Bot
+{
+  AudioPrewarmer::AudioPrewarmer(QuestionBank &bank, const PrewarmConfig &config, Cached cached, Upload upload)
+      : bank_(bank), config_(config), cached_(std::move(cached)), upload_(std::move(upload))
+  {
+    thread_ = std::thread(&AudioPrewarmer::run, this);
+  }
+
+  AudioPrewarmer::~AudioPrewarmer()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  bool AudioPrewarmer::pause(std::chrono::milliseconds delay)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !cv_.wait_for(lock, delay, [this]
+                         { return stopping_; });
+  }
+
+  bool AudioPrewarmer::wait(std::future<bool> uploaded)
+  {
+    // Finished on the HTTP client's thread, stopping doesn't wait for it
+    while (uploaded.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready)
+    {
+      if (!pause(UPLOAD_POLL))
+      {
+        return false;
+      }
+    }
+    try
+    {
+      return uploaded.get();
+    }
+    catch (const std::future_error &)
+    {
+      // Dropped unsent at shutdown
+      return false;
+    }
+  }
+
+  bool AudioPrewarmer::load()
+  {
+    std::vector<Level> levels;
+    for (unsigned jlpt : config_.levels)
+    {
+      Level level{jlpt, {}, 0};
+      try
+      {
+        const auto examples = bank_.level(jlpt).audioExamples();
+        level.examples.assign(examples.begin(), examples.end());
+      }
+      catch (const std::exception &e)
+      {
+        LOG_EXCEPTION("Audio pre-warm level exception", e);
+        continue;
+      }
+      std::sort(level.examples.begin(), level.examples.end());
+      level.cached = count(level);
+      LOG_INFO("Audio pre-warm: level {} has {} of {} clips cached\n", jlpt, level.cached, level.examples.size());
+      levels.push_back(std::move(level));
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_)
+      {
+        return false;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    levels_ = std::move(levels);
+    return !levels_.empty();
+  }
+
+  size_t AudioPrewarmer::count(const Level &level) const
+  {
+    return std::count_if(level.examples.begin(), level.examples.end(), cached_);
+  }
+
+  void AudioPrewarmer::record(uint32_t exampleID)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Level &level : levels_)
+    {
+      level.cached += std::binary_search(level.examples.begin(), level.examples.end(), exampleID);
+    }
+  }
+
+  void AudioPrewarmer::run()
+  {
+    if (!load())
+    {
+      return;
+    }
+
+    const std::chrono::milliseconds interval(config_.intervalMs);
+    // levels_ only changes in load(), reading the example lists needs no lock here
+    bool uploadedAny = true;
+    while (uploadedAny)
+    {
+      uploadedAny = false;
+      for (const Level &level : levels_)
+      {
+        for (uint32_t exampleID : level.examples)
+        {
+          if (cached_(exampleID))
+          {
+            continue;
+          }
+          if (!pause(interval))
+          {
+            return;
+          }
+          if (wait(upload_(exampleID)))
+          {
+            uploaded_++;
+            uploadedAny = true;
+            record(exampleID);
+          }
+          else
+          {
+            failed_++;
+          }
+        }
+      }
+
+      // Clips cached by listening questions meanwhile are only seen by a recount
+      for (Level &level : levels_)
+      {
+        const size_t cached = count(level);
+        std::lock_guard<std::mutex> lock(mutex_);
+        level.cached = cached;
+      }
+    }
+
+    done_ = true;
+    for (const Coverage &level : coverage())
+    {
+      LOG_INFO("Audio pre-warm finished: level {} has {} of {} clips cached\n", level.jlpt, level.cached, level.examples);
+    }
+  }
+
+  std::vector<AudioPrewarmer::Coverage> AudioPrewarmer::coverage() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Coverage> result;
+    for (const Level &level : levels_)
+    {
+      result.push_back({level.jlpt, level.examples.size(), level.cached});
+    }
+    return result;
+  }
+
+  AudioPrewarmer::Stats AudioPrewarmer::stats() const
+  {
+    Stats result;
+    result.uploaded = uploaded_;
+    result.failed = failed_;
+    result.done = done_;
+    return result;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "botconfig.hpp"
+#include "questionbank.hpp"
+
+namespace Bot
+{
+  // Background job that uploads listening clips before anyone asks for
+  // them. It walks the audio examples of the configured levels, one upload
+  // per interval, and hands every clip the cache doesn't know yet to the
+  // upload callback, which sends it to a private service chat and records
+  // its file ID. Stops after a pass that had nothing left to upload.
+  class AudioPrewarmer
+  {
+  public:
+    using Ptr = std::unique_ptr<AudioPrewarmer>;
+    using Cached = std::function<bool(uint32_t exampleID)>;
+    // Starts the upload. The result is false if the clip couldn't be
+    // uploaded, it is tried again on the next pass.
+    using Upload = std::function<std::future<bool>(uint32_t exampleID)>;
+
+    struct Coverage
+    {
+      unsigned jlpt = 0;
+      size_t examples = 0;
+      size_t cached = 0;
+    };
+
+    struct Stats
+    {
+      uint64_t uploaded = 0;
+      uint64_t failed = 0;
+      bool done = false;
+    };
+
+    AudioPrewarmer(QuestionBank &bank, const PrewarmConfig &config, Cached cached, Upload upload);
+    ~AudioPrewarmer();
+    AudioPrewarmer(const AudioPrewarmer &) = delete;
+    AudioPrewarmer &operator=(const AudioPrewarmer &) = delete;
+
+    // Empty until the levels are loaded and counted
+    std::vector<Coverage> coverage() const;
+    Stats stats() const;
+
+  private:
+    struct Level
+    {
+      unsigned jlpt;
+      // Sorted, a clip uploaded for one level is also counted for the others
+      std::vector<uint32_t> examples;
+      size_t cached = 0;
+    };
+
+    void run();
+    bool load();
+    size_t count(const Level &level) const;
+    // Waits for the interval, false once stopping
+    bool pause(std::chrono::milliseconds delay);
+    // Waits for an upload started by upload_, false if it failed or stopping
+    bool wait(std::future<bool> uploaded);
+    void record(uint32_t exampleID);
+
+    QuestionBank &bank_;
+    const PrewarmConfig config_;
+    Cached cached_;
+    Upload upload_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::vector<Level> levels_;
+
+    std::atomic<uint64_t> uploaded_ = 0;
+    std::atomic<uint64_t> failed_ = 0;
+    std::atomic<bool> done_ = false;
+    std::thread thread_;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "audiorelay.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <tgbot/tgbot.h>
+
+namespace
+{
+  constexpr long CONNECT_TIMEOUT_S = 10;
+  constexpr long TRANSFER_TIMEOUT_S = 60;
+
+  // Pulls result.audio.file_id out of the sendAudio response, empty if the
+  // response has none
+  std::string audioFileID(const std::string &response)
+  {
+    try
+    {
+      TgBot::TgTypeParser parser;
+      const boost::property_tree::ptree tree = parser.parseJson(response);
+      if (!tree.get<bool>("ok", false))
+      {
+        return std::string();
+      }
+      const TgBot::Message::Ptr message = parser.parseJsonAndGetMessage(tree.get_child("result"));
+      return message && message->audio ? message->audio->fileId : std::string();
+    }
+    catch (const std::exception &e)
+    {
+      LOG_EXCEPTION("Unparsable sendAudio response", e);
+      return std::string();
+    }
+  }
+
+  // Touched only on the HTTP client's loop thread once the transfers started
+  struct RelayState : std::enable_shared_from_this<RelayState>
+  {
+    RelayState(Bot::HttpClient &client, int64_t chat, const std::string &url, Bot::AudioRelay::Done callback)
+        : http(client), chatID(chat), sourceURL(url), done(std::move(callback))
+    {
+    }
+
+    Bot::HttpClient &http;
+    const int64_t chatID;
+    const std::string sourceURL;
+    Bot::AudioRelay::Done done;
+    CURL *download = nullptr;
+    CURL *upload = nullptr;
+    curl_mime *mime = nullptr;
+    Bot::ByteRing ring{Bot::AudioRelay::RING_SIZE};
+    bool downloadDone = false;
+    bool downloadFailed = false;
+    bool uploadDone = false;
+    bool downloadPaused = false;
+    bool uploadPaused = false;
+    bool resumeQueued = false;
+    CURLcode uploadResult = CURLE_FAILED_INIT;
+    long uploadStatus = 0;
+    std::string response;
+
+    // curl_easy_pause must not be called from another transfer's callback,
+    // the paused side is resumed from a task on the loop instead
+    void scheduleResume()
+    {
+      if (resumeQueued)
+      {
+        return;
+      }
+      resumeQueued = true;
+      http.post([self = shared_from_this()]()
+                { self->resume(); });
+    }
+
+    void resume()
+    {
+      resumeQueued = false;
+      if (uploadPaused && !uploadDone && (ring.size() || downloadDone))
+      {
+        uploadPaused = false;
+        curl_easy_pause(upload, CURLPAUSE_CONT);
+      }
+      // Once the upload is gone the download is resumed only to be aborted
+      if (downloadPaused && !downloadDone && (ring.space() || uploadDone))
+      {
+        downloadPaused = false;
+        curl_easy_pause(download, CURLPAUSE_CONT);
+      }
+    }
+
+    void transferDone()
+    {
+      if (!downloadDone || !uploadDone)
+      {
+        scheduleResume();
+        return;
+      }
+      // Both handles are out of the multi handle, nothing resumes them anymore
+      curl_easy_cleanup(download);
+      curl_easy_cleanup(upload);
+      curl_mime_free(mime);
+
+      Bot::AudioRelay::Result result;
+      result.uploaded = !downloadFailed && uploadResult == CURLE_OK && uploadStatus / 100 == 2;
+      if (!result.uploaded)
+      {
+        LOG_INFO("Audio relay to chat {} failed: {} (status {})\n", chatID, curl_easy_strerror(uploadResult), uploadStatus);
+      }
+      else
+      {
+        // The chat got the audio either way, only caching it needs the ID
+        result.fileID = audioFileID(response);
+        if (result.fileID.empty())
+        {
+          LOG_DEBUG("No file ID in sendAudio response: {}\n", response);
+        }
+      }
+      try
+      {
+        done(std::move(result));
+      }
+      catch (const std::exception &e)
+      {
+        LOG_EXCEPTION("Audio relay callback exception", e);
+      }
+    }
+  };
+
+  size_t onDownload(char *data, size_t size, size_t count, void *userdata)
+  {
+    auto state = static_cast<RelayState *>(userdata);
+    const size_t length = size * count;
+    if (state->uploadDone)
+    {
+      return 0;
+    }
+    // A paused write callback gets the same data again later, it must take all or nothing
+    if (state->ring.space() < length)
+    {
+      state->downloadPaused = true;
+      return CURL_WRITEFUNC_PAUSE;
+    }
+    state->ring.write(data, length);
+    if (state->uploadPaused)
+    {
+      state->scheduleResume();
+    }
+    return length;
+  }
+
+  size_t onUpload(char *buffer, size_t size, size_t count, void *userdata)
+  {
+    auto state = static_cast<RelayState *>(userdata);
+    if (state->downloadFailed)
+    {
+      return CURL_READFUNC_ABORT;
+    }
+    const size_t moved = state->ring.read(buffer, size * count);
+    if (moved)
+    {
+      if (state->downloadPaused)
+      {
+        state->scheduleResume();
+      }
+      return moved;
+    }
+    if (state->downloadDone)
+    {
+      return 0;
+    }
+    state->uploadPaused = true;
+    return CURL_READFUNC_PAUSE;
+  }
+
+  size_t onResponse(char *data, size_t size, size_t count, void *userdata)
+  {
+    static_cast<RelayState *>(userdata)->response.append(data, size * count);
+    return size * count;
+  }
+
+  void addField(curl_mime *mime, const char *name, const std::string &value)
+  {
+    curl_mimepart *part = curl_mime_addpart(mime);
+    curl_mime_name(part, name);
+    curl_mime_data(part, value.c_str(), value.size());
+  }
+}
+
+namespace Bot
+{
+  ByteRing::ByteRing(size_t capacity)
+      : buffer_(capacity)
+  {
+  }
+
+  size_t ByteRing::write(const char *data, size_t length)
+  {
+    length = std::min(length, space());
+    const size_t tail = (head_ + size_) % buffer_.size();
+    const size_t first = std::min(length, buffer_.size() - tail);
+    std::memcpy(buffer_.data() + tail, data, first);
+    std::memcpy(buffer_.data(), data + first, length - first);
+    size_ += length;
+    return length;
+  }
+
+  size_t ByteRing::read(char *data, size_t length)
+  {
+    length = std::min(length, size_);
+    const size_t first = std::min(length, buffer_.size() - head_);
+    std::memcpy(data, buffer_.data() + head_, first);
+    std::memcpy(data + first, buffer_.data(), length - first);
+    head_ = (head_ + length) % buffer_.size();
+    size_ -= length;
+    return length;
+  }
+
+  AudioRelay::AudioRelay(HttpClient &http, const std::string &token, const std::string &apiURL)
+      : http_(http), sendAudioURL_(apiURL + "/bot" + token + "/sendAudio")
+  {
+  }
+
+  void AudioRelay::relay(int64_t chatID, const std::string &sourceURL, const Audio &audio, Done done)
+  {
+    auto state = std::make_shared<RelayState>(http_, chatID, sourceURL, std::move(done));
+    RelayState *raw = state.get();
+
+    CURL *download = state->download = curl_easy_init();
+    curl_easy_setopt(download, CURLOPT_URL, state->sourceURL.c_str());
+    curl_easy_setopt(download, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(download, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(download, CURLOPT_CONNECTTIMEOUT, CONNECT_TIMEOUT_S);
+    curl_easy_setopt(download, CURLOPT_TIMEOUT, TRANSFER_TIMEOUT_S);
+    curl_easy_setopt(download, CURLOPT_WRITEFUNCTION, &onDownload);
+    curl_easy_setopt(download, CURLOPT_WRITEDATA, raw);
+
+    CURL *upload = state->upload = curl_easy_init();
+    curl_mime *mime = state->mime = curl_mime_init(upload);
+    addField(mime, "chat_id", std::to_string(chatID));
+    addField(mime, "caption", audio.caption);
+    addField(mime, "performer", audio.performer);
+    addField(mime, "title", audio.title);
+    curl_mimepart *file = curl_mime_addpart(mime);
+    curl_mime_name(file, "audio");
+    curl_mime_filename(file, "audio.mp3");
+    curl_mime_type(file, "audio/mpeg");
+    // Unknown size: the body is sent chunked as the download progresses
+    curl_mime_data_cb(file, -1, &onUpload, nullptr, nullptr, raw);
+    curl_easy_setopt(upload, CURLOPT_URL, sendAudioURL_.c_str());
+    curl_easy_setopt(upload, CURLOPT_MIMEPOST, mime);
+    curl_easy_setopt(upload, CURLOPT_CONNECTTIMEOUT, CONNECT_TIMEOUT_S);
+    curl_easy_setopt(upload, CURLOPT_TIMEOUT, TRANSFER_TIMEOUT_S);
+    curl_easy_setopt(upload, CURLOPT_WRITEFUNCTION, &onResponse);
+    curl_easy_setopt(upload, CURLOPT_WRITEDATA, raw);
+
+    http_.start(download, [state](CURLcode result, long)
+                {
+                  state->downloadDone = true;
+                  state->downloadFailed = result != CURLE_OK;
+                  if (state->downloadFailed && !state->uploadDone)
+                  {
+                    LOG_INFO("Audio download from {} failed: {}\n", state->sourceURL, curl_easy_strerror(result));
+                  }
+                  state->transferDone(); });
+    http_.start(upload, [state](CURLcode result, long status)
+                {
+                  state->uploadDone = true;
+                  state->uploadResult = result;
+                  state->uploadStatus = status;
+                  state->transferDone(); });
+  }
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "httpclient.hpp"
+
+namespace Bot
+{
+  // Fixed-size byte FIFO between a producer and a consumer on the same thread
+  class ByteRing
+  {
+  public:
+    explicit ByteRing(size_t capacity);
+
+    size_t size() const { return size_; }
+    size_t space() const { return buffer_.size() - size_; }
+    // Both return the number of bytes actually moved
+    size_t write(const char *data, size_t length);
+    size_t read(char *data, size_t length);
+
+  private:
+    std::vector<char> buffer_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+  };
+
+  // Relays an audio file from a URL into a Bot API sendAudio upload without
+  // touching the disk. Both transfers run on the shared HTTP client: the
+  // download's write callback fills a ring buffer and the upload's multipart
+  // body drains it, each side pausing while the buffer is full or empty. The
+  // upload starts with the first downloaded bytes and nothing waits for it:
+  // the caller hears back on the client's loop thread.
+  class AudioRelay
+  {
+  public:
+    using Ptr = std::unique_ptr<AudioRelay>;
+
+    static constexpr size_t RING_SIZE = 64 * 1024;
+
+    struct Audio
+    {
+      std::string caption;
+      std::string performer;
+      std::string title;
+    };
+
+    struct Result
+    {
+      // Telegram took the audio, the chat has it
+      bool uploaded = false;
+      // Empty if the upload failed or its response had none
+      std::string fileID;
+    };
+    // Called on the HTTP client's loop thread, it must not block
+    using Done = std::function<void(Result result)>;
+
+    AudioRelay(HttpClient &http, const std::string &token, const std::string &apiURL = "https://api.telegram.org");
+
+    // Starts both transfers and returns, done is called once both ended
+    void relay(int64_t chatID, const std::string &sourceURL, const Audio &audio, Done done);
+
+  private:
+    HttpClient &http_;
+    const std::string sendAudioURL_;
+  };
+}
\ No newline at end of file
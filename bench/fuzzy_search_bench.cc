@@ -0,0 +1,126 @@
+// Latency of the fuzzy fallback over the full JMdict key set: the keys the
+// inline suggestions are built from (writings, readings, romaji and gloss
+// words of every entry in the dictionary image), queried with keys that got
+// one or two random typos.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "dictionaryimage.hpp"
+#include "levenshtein.hpp"
+#include "suggestionindex.hpp"
+#include "transliteration.hpp"
+
+namespace
+{
+  constexpr int QUERIES = 2000;
+
+  std::string typo(std::string_view key, int edits, std::mt19937 &gen)
+  {
+    std::u32string text;
+    for (size_t pos = 0; pos < key.size();)
+    {
+      text.push_back(Bot::nextCodePoint(key, pos));
+    }
+    for (int i = 0; i < edits && !text.empty(); ++i)
+    {
+      const size_t at = gen() % text.size();
+      const char32_t c = text[gen() % text.size()];
+      switch (gen() % 3)
+      {
+      case 0:
+        text[at] = c;
+        break;
+      case 1:
+        text.insert(text.begin() + at, c);
+        break;
+      default:
+        text.erase(text.begin() + at);
+      }
+    }
+    std::string result;
+    for (const char32_t c : text)
+    {
+      if (c < 0x80)
+      {
+        result += static_cast<char>(c);
+      }
+      else if (c < 0x800)
+      {
+        result += static_cast<char>(0xC0 | (c >> 6));
+        result += static_cast<char>(0x80 | (c & 0x3F));
+      }
+      else
+      {
+        result += static_cast<char>(0xE0 | (c >> 12));
+        result += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        result += static_cast<char>(0x80 | (c & 0x3F));
+      }
+    }
+    return result;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const Bot::DictionaryImage::Ptr image = Bot::DictionaryImage::open(argc > 1 ? argv[1] : "dictionary.img");
+  if (!image)
+  {
+    std::fprintf(stderr, "usage: %s [dictionary.img]\n", argv[0]);
+    return 1;
+  }
+
+  const auto started = std::chrono::steady_clock::now();
+  Bot::SuggestionIndex::Builder builder;
+  std::vector<std::string> samples;
+  std::string romaji;
+  for (uint32_t entry = 0; entry < image->size(); ++entry)
+  {
+    const uint32_t suggestion = builder.add("", "", "");
+    for (const Bot::DictImage::Field field : {Bot::DictImage::writing, Bot::DictImage::reading})
+    {
+      for (const auto &value : image->values(entry, field))
+      {
+        builder.key(suggestion, image->string(value));
+        if (field == Bot::DictImage::reading)
+        {
+          builder.key(suggestion, Bot::Kana::toRomaji(image->string(value), romaji));
+          samples.emplace_back(entry % 2 ? image->string(value) : romaji);
+        }
+      }
+    }
+    for (const auto &value : image->values(entry, Bot::DictImage::gloss))
+    {
+      const std::string gloss = Bot::DictImage::normalize(image->string(value));
+      const std::string_view key(gloss);
+      builder.key(suggestion, key);
+      for (size_t space = key.find(' '); space != std::string_view::npos; space = key.find(' ', space + 1))
+      {
+        builder.key(suggestion, key.substr(space + 1));
+      }
+    }
+  }
+  const Bot::SuggestionIndex::Ptr index = builder.build();
+  const auto buildMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+  std::printf("index: %zu keys, %zu bytes, built in %lld ms\n", index->keys(), index->memoryUsage(), static_cast<long long>(buildMs));
+
+  std::mt19937 gen(42);
+  for (const unsigned edits : {1u, 2u})
+  {
+    std::vector<double> latencies;
+    size_t found = 0;
+    for (int i = 0; i < QUERIES; ++i)
+    {
+      const std::string query = typo(samples[gen() % samples.size()], edits, gen);
+      const auto queryStarted = std::chrono::steady_clock::now();
+      found += !index->fuzzy(query, edits, 5).empty();
+      latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - queryStarted).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("%u edit%s: p50 %8.0f us, p99 %8.0f us, max %8.0f us, %zu/%d corrected\n", edits, edits > 1 ? "s" : " ",
+                latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back(), found, QUERIES);
+  }
+  return 0;
+}
\ No newline at end of file
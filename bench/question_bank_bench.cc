@@ -0,0 +1,51 @@
+// Questions per second for the word quizzes: a JlptTraining constructed per
+// question (the old handlers) versus draws from the preloaded QuestionBank.
+// Pass a dictionary image to build the bank's vocabulary from it.
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "questionbank.hpp"
+
+namespace
+{
+  constexpr int TRAINING_QUESTIONS = 200;
+  constexpr int BANK_QUESTIONS = 200000;
+
+  volatile size_t sink = 0;
+
+  template <typename F>
+  double questionsPerSecond(int questions, F &&ask)
+  {
+    size_t total = 0;
+    const auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < questions; ++i)
+    {
+      total += ask();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    sink = total;
+    return questions / std::chrono::duration<double>(elapsed).count();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const double perQuestion = questionsPerSecond(TRAINING_QUESTIONS, []()
+                                                {
+                                                  Training::JlptTraining training(Bot::QuestionBank::QUIZ_LEVEL);
+                                                  const std::string word = training.getRandomWord();
+                                                  return training.prepareQuizReadingsForWord(word, 4).size(); });
+  std::printf("training per question: %12.0f questions/s\n", perQuestion);
+
+  const Bot::DictionaryImage::Ptr image = argc > 1 ? Bot::DictionaryImage::open(argv[1]) : nullptr;
+  Bot::QuestionBank bank(image.get());
+  const auto started = std::chrono::steady_clock::now();
+  const Bot::QuestionBank::Level &level = bank.level(Bot::QuestionBank::QUIZ_LEVEL);
+  const auto loadMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+  std::printf("bank load:             %12lld ms, %zu words, %zu bytes\n", static_cast<long long>(loadMs), level.size(), level.memoryUsage());
+
+  const double banked = questionsPerSecond(BANK_QUESTIONS, [&level]()
+                                           { return level.quizOptions(level.randomWord(), Bot::QuestionBank::QuizField::reading, 4).options.size(); });
+  std::printf("question bank:         %12.0f questions/s (%.0fx)\n", banked, banked / perQuestion);
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+// Per-call latency of the registration lookup with a freshly prepared
+// statement (the old UserManager::userExists) versus a pooled one.
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <SQLiteCpp/SQLiteCpp.h>
+#include "statementpool.hpp"
+
+namespace
+{
+  constexpr int USERS = 10000;
+  constexpr int CALLS = 200000;
+  constexpr const char *const LOOKUP = "SELECT ID FROM User WHERE ID = ?";
+
+  volatile size_t sink = 0;
+
+  template <typename F>
+  double nsPerCall(F &&call)
+  {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int64_t> dist(1, USERS * 2);
+    size_t found = 0;
+    const auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < CALLS; ++i)
+    {
+      found += call(dist(gen));
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    sink = found;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / CALLS;
+  }
+}
+
+int main()
+{
+  const std::string path = (std::filesystem::temp_directory_path() / "statement_pool_bench.db3").string();
+  std::filesystem::remove(path);
+  SQLite::Database db(path, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE | SQLite::OPEN_FULLMUTEX);
+  db.exec("PRAGMA main.journal_mode=WAL; PRAGMA main.synchronous=OFF;");
+  db.exec("CREATE TABLE User (ID INTEGER PRIMARY KEY AUTOINCREMENT, UserID INTEGER, Difficulty INTEGER DEFAULT 0, JLPT INTEGER DEFAULT 0)");
+  db.exec("BEGIN");
+  for (int i = 1; i <= USERS; ++i)
+  {
+    db.exec("INSERT INTO User (ID) VALUES (" + std::to_string(i) + ")");
+  }
+  db.exec("COMMIT");
+
+  const double prepared = nsPerCall([&db](int64_t id)
+                                    {
+                                      SQLite::Statement query(db, LOOKUP);
+                                      query.bind(1, id);
+                                      return query.executeStep(); });
+  std::printf("prepare per call: %8.0f ns/call\n", prepared);
+
+  Bot::StatementPool pool(db);
+  const double pooled = nsPerCall([&pool](int64_t id)
+                                  {
+                                    auto query = pool.acquire(LOOKUP);
+                                    query->bind(1, id);
+                                    return query->executeStep(); });
+  std::printf("statement pool:   %8.0f ns/call (%.1fx)\n", pooled, prepared / pooled);
+
+  std::filesystem::remove(path);
+  std::filesystem::remove(path + "-wal");
+  std::filesystem::remove(path + "-shm");
+  return 0;
+}
\ No newline at end of file
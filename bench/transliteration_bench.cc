@@ -0,0 +1,75 @@
+// Transliteration throughput in MB/s of input: the library's KanaProc versus
+// the table-driven engine, over the readings of the whole JLPT vocabulary.
+// The mixed corpus is what /search sees: mostly ASCII with some kana.
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "questionbank.hpp"
+#include "transliteration.hpp"
+
+namespace
+{
+  constexpr int ROUNDS = 20;
+
+  volatile size_t sink = 0;
+
+  size_t bytes(const std::vector<std::string> &corpus)
+  {
+    size_t total = 0;
+    for (const auto &text : corpus)
+    {
+      total += text.size();
+    }
+    return total;
+  }
+
+  template <typename F>
+  double megabytesPerSecond(const std::vector<std::string> &corpus, F &&convert)
+  {
+    size_t total = 0;
+    const auto started = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+      for (const auto &text : corpus)
+      {
+        total += convert(text);
+      }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    sink = total;
+    return ROUNDS * bytes(corpus) / 1e6 / std::chrono::duration<double>(elapsed).count();
+  }
+
+  void compare(const char *name, const std::vector<std::string> &corpus, bool toRomaji)
+  {
+    std::string buffer;
+    const double library = megabytesPerSecond(corpus, [toRomaji](const std::string &text)
+                                              { return (toRomaji ? KanaProc::toRomaji(text) : KanaProc::fromRomaji(text)).size(); });
+    const double tables = megabytesPerSecond(corpus, [toRomaji, &buffer](const std::string &text)
+                                             { return (toRomaji ? Bot::Kana::toRomaji(text, buffer) : Bot::Kana::fromRomaji(text, buffer)).size(); });
+    std::printf("%-20s KanaProc %8.1f MB/s, tables %8.1f MB/s (%.1fx), %zu strings, %zu bytes\n",
+                name, library, tables, tables / library, corpus.size(), bytes(corpus));
+  }
+}
+
+int main()
+{
+  Bot::QuestionBank bank;
+  const Bot::QuestionBank::Level &level = bank.level(Bot::QuestionBank::DEFAULT_LEVEL);
+
+  std::vector<std::string> readings, romaji, mixed;
+  std::string buffer;
+  for (uint32_t word = 0; word < level.size(); ++word)
+  {
+    const std::string_view reading = level.readings(word).front();
+    readings.emplace_back(reading);
+    romaji.emplace_back(Bot::Kana::toRomaji(reading, buffer));
+    mixed.push_back(std::string(level.glosses(word).front()) + " " + std::string(reading));
+  }
+
+  compare("toRomaji readings", readings, true);
+  compare("toRomaji mixed", mixed, true);
+  compare("fromRomaji readings", romaji, false);
+  return 0;
+}
\ No newline at end of file
@@ -1,9 +1,11 @@
 #include "botcommander.hpp"
-#include <curl/curl.h>
-#include "metrics/profiler.hpp"
 #include "log.hpp"
 
-#include <unordered_set>
+#include <algorithm>
+
+inline constexpr std::chrono::milliseconds PAGE_REPLY_TIMEOUT(10000);
+inline constexpr std::chrono::milliseconds QUIZ_SWEEP_PERIOD(30000);
+inline constexpr std::chrono::milliseconds SESSION_SWEEP_PERIOD(60000);
 
 inline constexpr const char *const SQL_OPTIONS =
     "PRAGMA main.page_size = 4096;"
@@ -15,7 +17,7 @@ inline constexpr const char *const SQL_OPTIONS =
 
 namespace Bot
 {
-  BotCommander::BotCommander(TgBot::Bot &bot)
+  BotCommander::BotCommander(TgBot::Bot &bot, const BotConfig &config)
       : bot_(bot)
   {
     try
@@ -27,16 +29,17 @@ namespace Bot
               SQLite::OPEN_FULLMUTEX);
       db_->exec(SQL_OPTIONS);
       db_->exec("CREATE TABLE IF NOT EXISTS AudioCache(ID INTEGER PRIMARY KEY AUTOINCREMENT, AudioID INT UNIQUE, TatoebaID INT UNIQUE);");
+      audioCache_ = std::make_unique<AudioCache>(*db_);
     }
     catch (const SQLite::Exception &e)
     {
       LOG_EXCEPTION("SQlite exception", e);
     }
 
-    userManager_ = std::make_unique<Bot::UserManager>(bot_);
+    userManager_ = std::make_unique<Bot::UserManager>(bot_, config);
 
     quizKeyboard_ = std::make_shared<TgBot::InlineKeyboardMarkup>();
-    createInlineKeyboard({{"Kana reading", "Word reading"}, {"Word meaning", "Listening"}, {"Numerals", "Random test"}}, quizKeyboard_);
+    createInlineKeyboard({{"Kana reading", "Word reading"}, {"Word meaning", "Listening"}, {"Numerals", "Verbs"}, {"Random test"}}, quizKeyboard_);
 
     continueKeyboard_ = std::make_shared<TgBot::InlineKeyboardMarkup>();
     createInlineKeyboard({{"One more"}, {"Stop"}}, continueKeyboard_);
@@ -56,14 +59,68 @@ namespace Bot
                           {"百", "千", "万", "零", "="}},
                          numeralKeyboard_);
 
-    search_ = std::make_shared<Search::DictSearch>();
+    image_ = DictionaryImage::open(config.dictionaryImage);
+    bank_ = std::make_unique<QuestionBank>(image_.get());
+    searchCache_ = std::make_unique<SearchCache>(config.searchCacheEntries, RESULTS_PER_PAGE);
+    fuzzyEdits_ = config.fuzzyEdits;
+    http_ = std::make_unique<HttpClient>(config.http);
+    relay_ = std::make_unique<AudioRelay>(*http_, bot_.getToken());
+    sender_ = std::make_unique<SendScheduler>(bot_, config.send);
+    pool_ = std::make_unique<ThreadPool>(config.workers, config.queueCapacity);
+    quizzes_ = std::make_unique<QuizStore>(config.quizCapacity, std::chrono::seconds(config.quizTtlSeconds));
+    sessions_ = std::make_unique<SessionManager>(*pool_, *quizzes_);
+    timers_ = std::make_unique<TimerWheel>();
+    scheduleQuizSweep();
+    // Never before the quiz TTL, an expiring quiz posts to its session
+    sessionIdle_ = std::chrono::seconds(std::max(config.sessionIdleSeconds, config.quizTtlSeconds));
+    scheduleSessionSweep();
+
+    if (image_)
+    {
+      // Word searches are answered from the image, the rest can wait for the library
+      pool_->submit([this]()
+                    { dictionary(); });
+    }
+    else
+    {
+      dictionary();
+    }
+    pool_->submit([this]()
+                  { buildSuggestions(); });
+    // Load the quiz levels now rather than on the first user's question,
+    // which waits for the load if it comes earlier
+    pool_->submit([this]()
+                  {
+                    quizLevel(0, QuestionBank::QUIZ_LEVEL);
+                    quizLevel(0, QuestionBank::DEFAULT_LEVEL); });
+    if (config.prewarm.chat)
+    {
+      const int64_t chatID = config.prewarm.chat;
+      prewarmer_ = std::make_unique<AudioPrewarmer>(
+          *bank_, config.prewarm,
+          [this](uint32_t exampleID)
+          { return audioCache_ && audioCache_->contains(exampleID); },
+          [this, chatID](uint32_t exampleID)
+          { return prewarmAudio(chatID, exampleID); });
+    }
 
     bot_.getEvents().onPollAnswer([this](TgBot::PollAnswer::Ptr answer)
-                                  { 
-                              processQuizReplies(answer);
-                              LOG_DEBUG("Poll answer received: {}\n", answer->user->id);                              
-                              this->userReplyStack_.erase(answer->user->id);
-                              this->bot_.getApi().sendMessage(answer->user->id, "Continue?", false, 0, continueKeyboard_); });
+                                  {
+                              LOG_DEBUG("Poll answer received: {}\n", answer->user->id);
+                              session(answer->user->id).post([this, answer]()
+                                                             {
+                                processQuizReplies(answer);
+                                this->sender_->sendMessage(answer->user->id, "Continue?", continueKeyboard_); }); });
+  }
+
+  BotCommander::~BotCommander()
+  {
+    // Relay callbacks and sender jobs post into user sessions, so both stop
+    // while the pool still runs. What the pool drains afterwards may queue
+    // replies, they are no longer sent.
+    prewarmer_.reset();
+    http_->stop();
+    sender_->stop();
   }
 
   const BotCommander &BotCommander::wordOfDay(int64_t userId)
@@ -71,6 +128,89 @@ namespace Bot
     return *this;
   }
 
+  UserSession &BotCommander::session(int64_t userID)
+  {
+    return sessions_->get(userID);
+  }
+
+  Search::DictSearch &BotCommander::dictionary()
+  {
+    std::call_once(searchLoaded_, [this]()
+                   {
+                     const auto started = std::chrono::steady_clock::now();
+                     search_ = std::make_shared<Search::DictSearch>();
+                     LOG_INFO("Dictionary library loaded in {}ms\n",
+                              std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count()); });
+    return *search_;
+  }
+
+  const QuestionBank::Level *BotCommander::quizLevel(int64_t userID, unsigned jlpt)
+  {
+    try
+    {
+      return &bank_->level(jlpt);
+    }
+    catch (const std::runtime_error &e)
+    {
+      LOG_DEBUG("Error: {}\n", e.what());
+      if (userID)
+      {
+        sender_->sendMessage(userID, std::format("Error: {}", e.what()));
+      }
+      return nullptr;
+    }
+  }
+
+  void BotCommander::reportMetrics() const
+  {
+    const auto pool = pool_->stats();
+    LOG_INFO("Pool: workers={} queue={} max_queue={} completed={} stolen={} throttled={}\n",
+             pool.workers, pool.queueDepth, pool.maxQueueDepth, pool.completed, pool.stolen, pool.throttled);
+    LOG_INFO("Pool latency: wait avg={}us max={}us, run avg={}us max={}us\n",
+             pool.avgWaitUs, pool.maxWaitUs, pool.avgRunUs, pool.maxRunUs);
+    LOG_INFO("Sessions: {} (evicted {}), pending timers: {}\n", sessions_->size(), sessions_->evicted(), timers_->pending());
+    const auto quizzes = quizzes_->stats();
+    LOG_INFO("Quizzes: active={} slots={}/{} bytes={} started={} expired={} rejected={}\n",
+             quizzes.active, quizzes.allocated, quizzes.capacity, quizzes.bytes, quizzes.started, quizzes.expired, quizzes.rejected);
+    const auto userStatements = userManager_->statementStats();
+    const auto audio = audioCache_ ? audioCache_->stats() : AudioCache::Stats();
+    LOG_INFO("Statements: users prepared={} reused={}, audio cache prepared={} reused={}\n",
+             userStatements.prepared, userStatements.reused, audio.statements.prepared, audio.statements.reused);
+    const uint64_t audioLookups = audio.hits + audio.misses;
+    LOG_INFO("Audio cache: entries={} hits={} misses={} hit_ratio={}% failed_writes={}\n",
+             audio.entries, audio.hits, audio.misses, audioLookups ? audio.hits * 100 / audioLookups : 0, audio.failedWrites);
+    LOG_INFO("Registered users: {}\n", userManager_->registeredUsers());
+    const auto quiz = userManager_->quizStats();
+    LOG_INFO("Quiz stats: recorded={} flushes={} failed={} max_flush={}us\n",
+             quiz.recorded, quiz.flushes, quiz.failedFlushes, quiz.maxFlushUs);
+    const auto search = searchCache_->stats();
+    const uint64_t lookups = search.hits + search.misses;
+    LOG_INFO("Search cache: entries={} bytes={} hits={} misses={} hit_ratio={}% evictions={}\n",
+             search.entries, search.bytes, search.hits, search.misses, lookups ? search.hits * 100 / lookups : 0, search.evictions);
+    LOG_INFO("Fuzzy search: fallbacks={} corrected={}\n", fuzzySearches_.load(), fuzzyCorrected_.load());
+    if (const SuggestionIndex *suggestions = suggestions_.load(std::memory_order_acquire))
+    {
+      LOG_INFO("Inline suggestions: words={} keys={} bytes={} stale_queries={}\n",
+               suggestions->size(), suggestions->keys(), suggestions->memoryUsage(), staleInlineQueries_.load());
+    }
+    const auto http = http_->stats();
+    LOG_INFO("HTTP: active={} transfers={} new_connections={} retries={} failed={}\n",
+             http.active, http.transfers, http.connections, http.retries, http.failed);
+    if (prewarmer_)
+    {
+      const auto prewarm = prewarmer_->stats();
+      std::string coverage;
+      for (const auto &level : prewarmer_->coverage())
+      {
+        coverage += std::format(" level{}={}/{}", level.jlpt, level.cached, level.examples);
+      }
+      LOG_INFO("Audio pre-warm: uploaded={} failed={} done={}{}\n", prewarm.uploaded, prewarm.failed, prewarm.done, coverage);
+    }
+    const auto send = sender_->stats();
+    LOG_INFO("Send: queued={} texts={} requests={} coalesced={} rate_limited={} failed={}, delay avg={}us max={}us\n",
+             send.queued, send.texts, send.requests, send.coalesced, send.rateLimited, send.failed, send.avgDelayUs, send.maxDelayUs);
+  }
+
   void BotCommander::createOneColumnKeyboard(const std::vector<std::string> &buttonStrings, TgBot::ReplyKeyboardMarkup::Ptr &kb)
   {
     for (size_t i = 0; i < buttonStrings.size(); ++i)
@@ -128,212 +268,140 @@ namespace Bot
     }
   }
 
-  UserReply BotCommander::waitForUserReply(int64_t userID)
+  void BotCommander::paginate(int64_t userID, size_t size, Pagination::Renderer render)
   {
-    bot_.getApi().sendMessage(userID, "Show more?", false, 0, continueKeyboard_);
-    userReplyStack_[userID] = UserReply::waiting;
-    const auto start_time = std::chrono::steady_clock::now();
-    const auto timeout_duration = std::chrono::milliseconds(10000);
+    Pagination &pagination = session(userID).pagination;
+    pagination.reset();
+    pagination.size = size;
+    pagination.render = std::move(render);
+    showNextPage(userID);
+  }
 
-    while (userReplyStack_[userID] != UserReply::goon && userReplyStack_[userID] != UserReply::stop)
+  void BotCommander::showNextPage(int64_t userID)
+  {
+    Pagination &pagination = session(userID).pagination;
+    const size_t pageEnd = std::min(pagination.cursor + RESULTS_PER_PAGE, pagination.size);
+    while (pagination.cursor < pageEnd)
     {
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
-      if (std::chrono::steady_clock::now() - start_time > timeout_duration)
+      try
       {
-        LOG_DEBUG("Timeout while waiting for user reply\n");
-        userReplyStack_.erase(userID);
-        bot_.getApi().sendMessage(userID, "Timeout. Stopping.", false, 0, std::make_shared<TgBot::GenericReply>(), "Markdown");
-        return UserReply::stop;
+        pagination.render(pagination.cursor++);
+      }
+      catch (const std::exception &e)
+      {
+        LOG_EXCEPTION("Exception while rendering a result", e);
       }
     }
 
-    auto it = userReplyStack_.find(userID);
-    if (it == userReplyStack_.end())
+    if (!pagination.active())
     {
-      LOG_DEBUG("User ID not found in userReplyStack\n");
-      return UserReply::stop;
+      pagination.reset();
+      return;
     }
 
-    UserReply reply = it->second;
-    userReplyStack_.erase(it);
-    return reply;
+    pagination.generation++;
+    const uint64_t generation = pagination.generation;
+    sender_->sendMessage(userID, "Show more?", continueKeyboard_);
+    timers_->schedule(PAGE_REPLY_TIMEOUT, [this, userID, generation]()
+                      { session(userID).post([this, userID, generation]()
+                                             { this->expirePagination(userID, generation); }); });
   }
 
-  void BotCommander::registerQuizCallback(int64_t userID, ReplyCallback callback)
+  void BotCommander::expirePagination(int64_t userID, uint64_t generation)
   {
-    std::lock_guard<std::mutex> lock(replyCallbacksMutex);
-    LOG_DEBUG("Registering reply callback for user {}\n", userID);
-    replyCallbacks_[userID] = callback;
+    Pagination &pagination = session(userID).pagination;
+    if (!pagination.active() || pagination.generation != generation)
+    {
+      return;
+    }
+
+    LOG_DEBUG("Timeout while waiting for user reply\n");
+    pagination.reset();
+    sender_->sendMessage(userID, "Timeout. Stopping.", nullptr, "Markdown");
   }
 
-  void BotCommander::unregisterQuizCallback(int64_t userID)
+  void BotCommander::scheduleQuizSweep()
   {
-    std::lock_guard<std::mutex> lock(replyCallbacksMutex);
-    LOG_DEBUG("Unregistering reply callback for user {}\n", userID);
-    replyCallbacks_.erase(userID);
+    timers_->schedule(QUIZ_SWEEP_PERIOD, [this]()
+                      {
+                        quizzes_->sweep([this](int64_t userID)
+                                        { session(userID).post([this, userID]()
+                                                               { expireQuiz(userID); }); });
+                        scheduleQuizSweep(); });
   }
 
-  void BotCommander::processQuizReplies(TgBot::PollAnswer::Ptr answer)
+  void BotCommander::scheduleSessionSweep()
   {
-    auto it = replyCallbacks_.find(answer->user->id);
-    if (it != replyCallbacks_.end())
-    {
-      it->second(answer);
-      unregisterQuizCallback(answer->user->id);
-    }
+    timers_->schedule(SESSION_SWEEP_PERIOD, [this]()
+                      {
+                        sessions_->evict(sessionIdle_);
+                        scheduleSessionSweep(); });
   }
 
-  std::string BotCommander::getStringToken(const std::string &input, unsigned index)
+  void BotCommander::expireQuiz(int64_t userID)
   {
-    std::istringstream iss(input);
-    std::string token;
-
-    for (unsigned i = 1; i <= index; ++i)
+    // The command stays, "One more" still starts a new question
+    if (quizzes_->expire(session(userID).quiz))
     {
-      iss >> token;
-      if (!iss)
-      {
-        return std::string();
-      }
+      LOG_DEBUG("Quiz of user {} expired\n", userID);
     }
-
-    return token;
   }
 
-  bool BotCommander::storeAudioCache(const std::string &audioID, uint32_t tatoebaID)
+  void BotCommander::recordQuizAnswer(int64_t userID, QuizKind kind, bool correct)
   {
-    try
-    {
-      SQLite::Statement stmt(*db_, "INSERT OR IGNORE INTO AudioCache (AudioID, TatoebaID) VALUES (?, ?);");
-      LOG_DEBUG("Storing audio cache: {} {}\n", audioID, tatoebaID);
-      stmt.bind(1, audioID);
-      stmt.bind(2, tatoebaID);
-      stmt.exec();
-    }
-    catch (const std::exception &e)
+    userManager_->recordQuizAnswer(userID, kind, correct);
+    if (session(userID).randomQuiz)
     {
-      LOG_EXCEPTION("Audio Cache exception", e);
-      return false;
+      userManager_->recordQuizAnswer(userID, QuizKind::random, correct);
     }
-    return true;
   }
 
-  std::string BotCommander::getAudioCache(uint32_t tatoebaID)
+  void BotCommander::registerQuizCallback(int64_t userID, ReplyCallback callback)
   {
-    try
-    {
-      SQLite::Statement stmt(*db_, "SELECT AudioID FROM AudioCache WHERE TatoebaID = ?");
-      stmt.bind(1, tatoebaID);
-      if (stmt.executeStep())
-      {
-        return stmt.getColumn("AudioID").getText();
-      }
-    }
-    catch (const std::exception &e)
-    {
-      LOG_EXCEPTION("Audio Cache exception", e);
-    }
-    return std::string();
+    LOG_DEBUG("Registering reply callback for user {}\n", userID);
+    session(userID).quizReply = std::move(callback);
   }
 
-  size_t BotCommander::downloadCallback(void *ptr, size_t size, size_t nmemb, void *stream)
+  void BotCommander::unregisterQuizCallback(int64_t userID)
   {
-    if (!stream)
-    {
-      return size * nmemb;
-    }
-    size_t written = fwrite(ptr, size, nmemb, (FILE *)stream);
-    return written;
+    LOG_DEBUG("Unregistering reply callback for user {}\n", userID);
+    session(userID).quizReply = nullptr;
   }
 
-  std::string BotCommander::downloadURL(const std::string &url, const std::string &targetFilename, bool force)
+  void BotCommander::processQuizReplies(TgBot::PollAnswer::Ptr answer)
   {
-    RECORD_CALL();
-    if (targetFilename.empty())
-    {
-      LOG_DEBUG("Target file for downloading is empty.\n");
-      return std::string();
-    }
-
-    if (!force && std::filesystem::exists(targetFilename))
+    ReplyCallback callback = std::move(session(answer->user->id).quizReply);
+    unregisterQuizCallback(answer->user->id);
+    if (callback)
     {
-      LOG_DEBUG("Target file {} already exists and no force flag was specified\n", targetFilename);
-      return targetFilename;
+      callback(answer);
     }
+  }
 
-    curl_global_init(CURL_GLOBAL_ALL);
-    CURL *curl_handle = curl_easy_init();
-    curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl_handle, CURLOPT_VERBOSE, 0L);
-    curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1L);
-    curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, &downloadCallback);
-    curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl_handle, CURLOPT_FAILONERROR, true);
-    char errbuf[CURL_ERROR_SIZE] = {0};
-    curl_easy_setopt(curl_handle, CURLOPT_ERRORBUFFER, errbuf);
-    curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "Mozilla/5.0...");
-
-    LOG_DEBUG("Downloading {} to {}\n", url, targetFilename);
-    errno = 0;
-    FILE *targetFile = fopen(targetFilename.c_str(), "wb");
-    if (!targetFile)
-    {
-      LOG_DEBUG("Error occurred while opening file.\n");
-      return std::string();
-    }
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, targetFile);
-    const int max_attempts = 5;
-    CURLcode retcode = CURLE_FAILED_INIT;
+  std::string BotCommander::getStringToken(const std::string &input, unsigned index)
+  {
+    std::istringstream iss(input);
+    std::string token;
 
-    for (int i = 1; i <= max_attempts; i++)
+    for (unsigned i = 1; i <= index; ++i)
     {
-      try
-      {
-        retcode = curl_easy_perform(curl_handle);
-        long response_code = 0;
-        curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
-        LOG_INFO("HTTP Response Code: {}\n", response_code);
-        if (retcode == CURLE_OK)
-        {
-          break;
-        }
-        LOG_INFO("CURL error: {0}\nRetrying...\n", (uint32_t)retcode);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10000));
-      }
-      catch (...)
+      iss >> token;
+      if (!iss)
       {
-        LOG_INFO("Exception occurred while downloading file.\n");
-        break;
+        return std::string();
       }
     }
 
-    if (CURLE_OK != retcode)
-    {
-      LOG_INFO("CURL error: {0}\n", errbuf);
-    }
-    fclose(targetFile);
-
-    curl_easy_cleanup(curl_handle);
-    curl_global_cleanup();
-    return CURLE_OK == retcode ? targetFilename : std::string();
+    return token;
   }
 
-  std::string BotCommander::escapeMarkdownV2(const std::string &input)
+  bool BotCommander::storeAudioCache(const std::string &fileID, uint32_t exampleID)
   {
-    std::unordered_set<char> mdSpecialChars = {
-        '_', '*', '[', ']', '(', ')', '~', '`', '>', '#', '+', '-', '=', '|', '{', '}', '.', '!'};
-
-    std::string result;
-    for (char c : input)
-    {
-      if (mdSpecialChars.count(c))
-      {
-        result += '\\'; // Add escape character
-      }
-      result += c;
-    }
+    return audioCache_ && audioCache_->store(exampleID, fileID);
+  }
 
-    return result;
+  std::string BotCommander::getAudioCache(uint32_t exampleID)
+  {
+    return audioCache_ ? audioCache_->find(exampleID) : std::string();
   }
 }
\ No newline at end of file
@@ -4,36 +4,27 @@
 #include <unordered_map>
 #include <tgbot/tgbot.h>
 #include <SQLiteCpp/SQLiteCpp.h>
+#include "audiocache.hpp"
+#include "audioprewarmer.hpp"
+#include "audiorelay.hpp"
+#include "botconfig.hpp"
+#include "httpclient.hpp"
+#include "dictionaryimage.hpp"
+#include "entrybatch.hpp"
+#include "questionbank.hpp"
+#include "searchcache.hpp"
+#include "suggestionindex.hpp"
+#include "sendscheduler.hpp"
+#include "statementpool.hpp"
+#include "threadpool.hpp"
+#include "timerwheel.hpp"
 #include "usermanager.hpp"
+#include "usersession.hpp"
 #include "waka.hpp"
 
 namespace Bot
 {
   bool containsAny(const std::vector<std::string> &list1, const std::vector<std::string> &list2);
-  int findMatchingIndex(const std::vector<std::string> &where, const std::string &what);
-
-  enum class BotCommand
-  {
-    none,
-    searchSingleWord,
-    searchExample,
-    explainInput,
-    gameKanaReading,
-    gameAudition,
-    gameMeaning,
-    gameReading,
-    gameNumerals,
-    stop,
-    outputPause,
-  };
-
-  enum class UserReply
-  {
-    none,
-    waiting,
-    goon,
-    stop
-  };
 
   enum class DifficultyLevel
   {
@@ -43,24 +34,22 @@ namespace Bot
     ultra,
   };
 
-  using CommandStack = std::unordered_map<int64_t /*userId*/, BotCommand>;
-  using UserReplyStack = std::unordered_map<int64_t /*userId*/, UserReply>;
-
   class BotCommander
   {
   public:
     using Ptr = std::unique_ptr<BotCommander>;
-    using ReplyCallback = std::function<void(TgBot::PollAnswer::Ptr answer)>;
+    using ReplyCallback = UserSession::ReplyCallback;
+
+    static constexpr size_t RESULTS_PER_PAGE = 5;
 
-    BotCommander(TgBot::Bot &bot);
-    ~BotCommander() = default;
+    BotCommander(TgBot::Bot &bot, const BotConfig &config = BotConfig());
+    ~BotCommander();
     BotCommander(const BotCommander &) = delete;
     BotCommander &operator=(const BotCommander &) = delete;
 
     void parseCommand(const TgBot::Message::Ptr &message);
     void parseCallback(const TgBot::CallbackQuery::Ptr &query);
     void parseUserInput(const TgBot::Message::Ptr &message);
-    void parseUserInputAsync(const TgBot::Message::Ptr &message);
     void parseInlineQuery(const TgBot::InlineQuery::Ptr &query);
     void parseChosenInlineResult(const TgBot::ChosenInlineResult::Ptr &result);
     void parseEditedMessage(const TgBot::Message::Ptr &message);
@@ -69,45 +58,98 @@ namespace Bot
     const BotCommander &settings(int64_t userId);
     const BotCommander &wordOfDay(int64_t userId);
 
-    void handleQuizReply(TgBot::PollAnswer::Ptr answer);
+    void handleQuizReply(TgBot::PollAnswer::Ptr answer, QuizKind kind, int32_t correctIndex);
     void processQuizReplies(TgBot::PollAnswer::Ptr answer);
 
+    void reportMetrics() const;
+
   private:
+    UserSession &session(int64_t userID);
+    // The dictionary library, loaded on first use
+    Search::DictSearch &dictionary();
+    // Calls visit(index, writings, readings, glosses) for every ID, from the
+    // image when there is one (its IDs differ from the library's). Image
+    // values are views into the mapping, library values are fetched per ID
+    // and only live for the call, so visit has to take either kind of range.
+    template <typename Visit>
+    void visitEntries(std::span<const uint32_t> ids, Visit &&visit)
+    {
+      if (image_)
+      {
+        const EntryBatch entries(*image_, ids);
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+          visit(i, entries.get(i, EntryBatch::writing), entries.get(i, EntryBatch::reading), entries.get(i, EntryBatch::gloss));
+        }
+        return;
+      }
+      Search::Jmdict &jmdict = *dictionary().jmdict;
+      for (size_t i = 0; i < ids.size(); ++i)
+      {
+        visit(i, jmdict.kanji_by_id(ids[i]), jmdict.reading_by_id(ids[i]), jmdict.gloss_by_id(ids[i]));
+      }
+    }
+    void processCommand(const TgBot::Message::Ptr &message);
+    void processCallback(const TgBot::CallbackQuery::Ptr &query);
+    void processUserInput(const TgBot::Message::Ptr &message);
+
     std::string getStringToken(const std::string &str, unsigned index);
     const BotCommander &commandSearchWord(const TgBot::Message::Ptr &query);
+    std::vector<uint32_t> searchWords(const std::string &input);
+    std::vector<uint32_t> searchImage(const std::string &query, const std::string &input, const std::string &alternate);
+    SearchCache::Result::Ptr searchFuzzy(const std::string &input, std::string &correction);
+    std::vector<uint32_t> searchCorrected(const std::string &key);
+    std::vector<uint32_t> searchDeinflected(const std::string &input);
     const BotCommander &commandSearchExample(const TgBot::Message::Ptr &query);
 
     const BotCommander &commandWordAllInfo(const TgBot::Message::Ptr &query);
+    std::vector<std::string> renderWords(std::span<const uint32_t> ids);
+    std::vector<std::string> renderExamples(std::span<const uint32_t> ids);
+    std::vector<std::string> renderWordInfo(std::span<const uint32_t> ids);
+    void buildSuggestions();
+    void answerInlineQuery(const TgBot::InlineQuery::Ptr &query, uint64_t generation);
 
     const BotCommander &commandQuizKanaReading(int64_t userID);
     const BotCommander &commandQuizKanaReading(TgBot::Message::Ptr message);
     const BotCommander &commandQuizWordReading(int64_t userID);
     const BotCommander &commandQuizWordMeaning(int64_t userID);
     const BotCommander &commandQuizListening(int64_t userID);
+    const BotCommander &commandQuizVerbs(int64_t userID);
+    AudioRelay::Audio tatoebaAudio(uint32_t audioID);
+    // Handles the end of a listening clip's relay on the user's strand
+    void audioRelayed(int64_t userID, uint32_t exampleID, const std::string &audioURL, const AudioRelay::Audio &audio,
+                      const AudioRelay::Result &result);
+    // Uploads the clip to the chat and caches its file ID, see AudioPrewarmer
+    std::future<bool> prewarmAudio(int64_t chatID, uint32_t exampleID);
     const BotCommander &commandQuizNumeralsRandomAsync(int64_t userID);
     const BotCommander &commandQuizJapaneseNumerals(int64_t userID);
     const BotCommander &commandQuizNumeralCounters(int64_t userID);
     const BotCommander &commandQuizNumeralsCallback(int64_t userID, const std::string &data);
     const BotCommander &commandQuizRandom(int64_t userID);
-    void commandQuizRandomAsync(int64_t userID);
 
+    // Reports the failure to the user and returns nullptr if the level can't be loaded
+    const QuestionBank::Level *quizLevel(int64_t userID, unsigned jlpt);
+    void recordQuizAnswer(int64_t userID, QuizKind kind, bool correct);
     void registerQuizCallback(int64_t userID, ReplyCallback callback);
     void unregisterQuizCallback(int64_t userID);
 
     void createOneColumnKeyboard(const std::vector<std::string> &buttonStrings, TgBot::ReplyKeyboardMarkup::Ptr &kb);
     void createKeyboard(const std::vector<std::vector<std::string>> &buttonLayout, TgBot::ReplyKeyboardMarkup::Ptr &kb);
     void createInlineKeyboard(const std::vector<std::vector<std::string>> &buttonLayout, TgBot::InlineKeyboardMarkup::Ptr &kb);
-    static size_t downloadCallback(void *ptr, size_t size, size_t nmemb, void *stream);
-    UserReply waitForUserReply(int64_t userID);
+    void paginate(int64_t userID, size_t size, Pagination::Renderer render);
+    void showNextPage(int64_t userID);
+    void expirePagination(int64_t userID, uint64_t generation);
+    void scheduleQuizSweep();
+    void scheduleSessionSweep();
+    void expireQuiz(int64_t userID);
 
   private:
-    std::string escapeMarkdownV2(const std::string &input);
-    std::string downloadURL(const std::string &url, const std::string &targetFilename, bool force);
-    bool storeAudioCache(const std::string &audioID, uint32_t tatoebaID);
-    std::string getAudioCache(uint32_t tatoebaID);
+    bool storeAudioCache(const std::string &fileID, uint32_t exampleID);
+    std::string getAudioCache(uint32_t exampleID);
 
     TgBot::Bot &bot_;
     std::unique_ptr<SQLite::Database> db_;
+    AudioCache::Ptr audioCache_;
     DifficultyLevel difficultyLevel_ = DifficultyLevel::easy;
     Bot::UserManager::Ptr userManager_;
 
@@ -116,13 +158,32 @@ namespace Bot
     TgBot::InlineKeyboardMarkup::Ptr difficultyLevelKeyboard_;
     TgBot::InlineKeyboardMarkup::Ptr numeralKeyboard_;
 
-    CommandStack commandStack_;
-    UserReplyStack userReplyStack_;
-
+    DictionaryImage::Ptr image_;
+    std::once_flag searchLoaded_;
     Search::DictSearch::Ptr search_;
-    std::string quizRandomKana_;
-
-    std::map<int64_t, ReplyCallback> replyCallbacks_;
-    std::mutex replyCallbacksMutex;
+    QuestionBank::Ptr bank_;
+    SearchCache::Ptr searchCache_;
+    size_t fuzzyEdits_ = 0;
+    std::atomic<uint64_t> fuzzySearches_ = 0;
+    std::atomic<uint64_t> fuzzyCorrected_ = 0;
+    // Built in the background, published through suggestions_
+    SuggestionIndex::Ptr suggestionIndex_;
+    std::atomic<const SuggestionIndex *> suggestions_ = nullptr;
+    std::atomic<uint64_t> staleInlineQueries_ = 0;
+    QuizStore::Ptr quizzes_;
+    SessionManager::Ptr sessions_;
+    std::chrono::seconds sessionIdle_{0};
+    // Sender jobs relay audio, both outlive the sender
+    HttpClient::Ptr http_;
+    AudioRelay::Ptr relay_;
+    // Outlives the pool, handlers queue their replies here.
+    SendScheduler::Ptr sender_;
+    // Uploads through the sender, stopped before it
+    AudioPrewarmer::Ptr prewarmer_;
+
+    // Declared last so that in-flight handlers are drained before the state they touch goes away.
+    ThreadPool::Ptr pool_;
+    // Stopped before the pool, its callbacks post into user sessions.
+    TimerWheel::Ptr timers_;
   };
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "botconfig.hpp"
+#include "log.hpp"
+
+#include <cstdlib>
+
+namespace
+{
+  size_t readSize(const char *name, size_t fallback)
+  {
+    const char *value = getenv(name);
+    if (!value || !*value)
+    {
+      return fallback;
+    }
+
+    char *end = nullptr;
+    unsigned long long parsed = std::strtoull(value, &end, 10);
+    if (*end)
+    {
+      LOG_INFO("Ignoring invalid {}={}\n", name, value);
+      return fallback;
+    }
+    return static_cast<size_t>(parsed);
+  }
+
+  int64_t readInt64(const char *name, int64_t fallback)
+  {
+    const char *value = getenv(name);
+    if (!value || !*value)
+    {
+      return fallback;
+    }
+
+    char *end = nullptr;
+    long long parsed = std::strtoll(value, &end, 10);
+    if (*end)
+    {
+      LOG_INFO("Ignoring invalid {}={}\n", name, value);
+      return fallback;
+    }
+    return static_cast<int64_t>(parsed);
+  }
+
+  // Comma-separated list such as "5,4,3"
+  std::vector<unsigned> readList(const char *name, const std::vector<unsigned> &fallback)
+  {
+    const char *value = getenv(name);
+    if (!value || !*value)
+    {
+      return fallback;
+    }
+
+    std::vector<unsigned> parsed;
+    for (const char *cursor = value; *cursor;)
+    {
+      char *end = nullptr;
+      parsed.push_back(static_cast<unsigned>(std::strtoul(cursor, &end, 10)));
+      if (end == cursor || (*end && *end != ','))
+      {
+        LOG_INFO("Ignoring invalid {}={}\n", name, value);
+        return fallback;
+      }
+      cursor = *end ? end + 1 : end;
+    }
+    return parsed;
+  }
+
+  std::string readString(const char *name, const std::string &fallback)
+  {
+    const char *value = getenv(name);
+    return value && *value ? value : fallback;
+  }
+}
+
+namespace Bot
+{
+  BotConfig BotConfig::fromEnvironment()
+  {
+    BotConfig config;
+    config.workers = readSize("WAKABOT_WORKERS", config.workers);
+    config.queueCapacity = readSize("WAKABOT_QUEUE_CAPACITY", config.queueCapacity);
+    config.pollTimeout = readSize("WAKABOT_POLL_TIMEOUT", config.pollTimeout);
+    config.send.senders = readSize("WAKABOT_SENDERS", config.send.senders);
+    config.send.globalRate = readSize("WAKABOT_SEND_RATE", config.send.globalRate);
+    config.send.chatRate = readSize("WAKABOT_SEND_CHAT_RATE", config.send.chatRate);
+    config.send.chatBurst = readSize("WAKABOT_SEND_CHAT_BURST", config.send.chatBurst);
+    config.http.hostConnections = readSize("WAKABOT_HTTP_HOST_CONNECTIONS", config.http.hostConnections);
+    config.http.maxAttempts = readSize("WAKABOT_HTTP_ATTEMPTS", config.http.maxAttempts);
+    config.http.backoffMs = readSize("WAKABOT_HTTP_BACKOFF_MS", config.http.backoffMs);
+    config.statsFlushMs = readSize("WAKABOT_STATS_FLUSH_MS", config.statsFlushMs);
+    config.statsFlushEvents = readSize("WAKABOT_STATS_FLUSH_EVENTS", config.statsFlushEvents);
+    config.searchCacheEntries = readSize("WAKABOT_SEARCH_CACHE", config.searchCacheEntries);
+    config.fuzzyEdits = readSize("WAKABOT_FUZZY_EDITS", config.fuzzyEdits);
+    config.dictionaryImage = readString("WAKABOT_DICTIONARY_IMAGE", config.dictionaryImage);
+    config.quizCapacity = readSize("WAKABOT_QUIZ_CAPACITY", config.quizCapacity);
+    config.quizTtlSeconds = readSize("WAKABOT_QUIZ_TTL", config.quizTtlSeconds);
+    config.sessionIdleSeconds = readSize("WAKABOT_SESSION_IDLE", config.sessionIdleSeconds);
+    config.prewarm.chat = readInt64("WAKABOT_PREWARM_CHAT", config.prewarm.chat);
+    config.prewarm.intervalMs = readSize("WAKABOT_PREWARM_INTERVAL_MS", config.prewarm.intervalMs);
+    config.prewarm.levels = readList("WAKABOT_PREWARM_LEVELS", config.prewarm.levels);
+    config.webhook.enabled = readSize("WAKABOT_WEBHOOK", config.webhook.enabled) != 0;
+    config.webhook.url = readString("WAKABOT_WEBHOOK_URL", config.webhook.url);
+    config.webhook.secret = readString("WAKABOT_WEBHOOK_SECRET", config.webhook.secret);
+    config.webhook.bind = readString("WAKABOT_WEBHOOK_BIND", config.webhook.bind);
+    config.webhook.port = readSize("WAKABOT_WEBHOOK_PORT", config.webhook.port);
+    config.webhook.path = readString("WAKABOT_WEBHOOK_PATH", config.webhook.path);
+    config.webhook.maxConnections = readSize("WAKABOT_WEBHOOK_CONNECTIONS", config.webhook.maxConnections);
+    config.webhook.maxClients = readSize("WAKABOT_WEBHOOK_CLIENTS", config.webhook.maxClients);
+    config.webhook.maxBodyBytes = readSize("WAKABOT_WEBHOOK_MAX_BODY", config.webhook.maxBodyBytes);
+    config.webhook.idleSeconds = readSize("WAKABOT_WEBHOOK_IDLE", config.webhook.idleSeconds);
+    return config;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Bot
+{
+  // Outbound request pacing, see SendScheduler
+  struct SendConfig
+  {
+    size_t senders = 4;
+    size_t globalRate = 30; // requests per second for the whole bot
+    size_t chatRate = 1;    // sustained requests per second for one chat
+    size_t chatBurst = 3;   // requests a quiet chat may send back to back
+    size_t lingerMs = 25;   // how long a lone text waits for a follow-up to merge with
+    size_t maxAttempts = 5;
+  };
+
+  // Shared HTTP client, see HttpClient
+  struct HttpConfig
+  {
+    size_t hostConnections = 4; // HTTP/1.1 connections kept per host, HTTP/2 multiplexes over one
+    size_t maxAttempts = 5;
+    size_t backoffMs = 500;      // delay before the first retry, doubled on every further one
+    size_t maxBackoffMs = 16000;
+    size_t dnsCacheSeconds = 300;
+  };
+
+  // Uploads listening clips ahead of the questions, see AudioPrewarmer
+  struct PrewarmConfig
+  {
+    int64_t chat = 0;                // private service chat the clips are uploaded to, 0 = off
+    size_t intervalMs = 2000;        // pause between two uploads
+    std::vector<unsigned> levels{0}; // JLPT levels to walk, 0 is the one listening draws from
+  };
+
+  // Update ingestion over a webhook instead of long polling, see WebhookServer
+  struct WebhookConfig
+  {
+    bool enabled = false;
+    std::string url;    // registered with Telegram at startup if set, e.g. https://bot.example.org/telegram
+    std::string secret; // X-Telegram-Bot-Api-Secret-Token Telegram is asked to send, empty = not checked
+    std::string bind = "127.0.0.1"; // HTTPS ends at a reverse proxy in front
+    size_t port = 8080;
+    std::string path = "/telegram"; // the only request target updates are taken on
+    size_t maxConnections = 40;     // parallel connections Telegram may open, 1 to 100
+    size_t maxClients = 1024;       // connections the server holds at once, more are closed on accept
+    size_t maxBodyBytes = 1 << 20;
+    size_t idleSeconds = 60; // a kept-alive connection without a request is closed after this long
+  };
+
+  // Runtime tunables. Defaults are used unless overridden by WAKABOT_* environment variables.
+  struct BotConfig
+  {
+    size_t workers = 0; // 0 = hardware concurrency
+    size_t queueCapacity = 4096;
+    size_t pollTimeout = 10; // seconds a getUpdates call may hang waiting for updates
+    SendConfig send;
+    HttpConfig http;
+    PrewarmConfig prewarm;
+    WebhookConfig webhook;
+    size_t statsFlushMs = 5000;    // quiz statistics are written at least this often
+    size_t statsFlushEvents = 256; // or as soon as this many answers are pending
+    size_t searchCacheEntries = 4096;
+    size_t fuzzyEdits = 2; // typos a search with no exact results may correct, 0 = off
+    std::string dictionaryImage = "dictionary.img"; // compiled by tools/dictcompiler, optional
+    size_t quizCapacity = 65536; // quizzes in progress at once, a new one is refused beyond that
+    size_t quizTtlSeconds = 600; // an untouched quiz is dropped after this long
+    size_t sessionIdleSeconds = 3600; // a user's session, command and paging included, after this long
+
+    static BotConfig fromEnvironment();
+  };
+}
\ No newline at end of file
@@ -15,117 +15,117 @@ namespace Bot
     int64_t chatID = query->message->chat->id;
     if (chatID < 0)
     {
-      bot_.getApi().sendMessage(chatID, "Groups are not supported yet.");
+      sender_->sendMessage(chatID, "Groups are not supported yet.");
       return;
     }
     LOG_DEBUG("User {} callback {}\n", userID, query->data);
+    session(userID).post([this, query]()
+                         { this->processCallback(query); });
+  }
 
+  void BotCommander::processCallback(const TgBot::CallbackQuery::Ptr &query)
+  {
+    int64_t userID = query->from->id;
+    UserSession &userSession = session(userID);
     if (StringTools::startsWith(query->data, "Kana reading"))
     {
-      std::thread([this, userID]()
-                  { this->commandQuizKanaReading(userID); })
-          .detach();
+      userSession.randomQuiz = false;
+      commandQuizKanaReading(userID);
     }
     else if (StringTools::startsWith(query->data, "Word reading"))
     {
-      std::thread([this, userID]()
-                  { this->commandQuizWordReading(userID); })
-          .detach();
+      userSession.randomQuiz = false;
+      commandQuizWordReading(userID);
     }
     else if (StringTools::startsWith(query->data, "Word meaning"))
     {
-      std::thread([this, userID]()
-                  { this->commandQuizWordMeaning(userID); })
-          .detach();
+      userSession.randomQuiz = false;
+      commandQuizWordMeaning(userID);
     }
     else if (StringTools::startsWith(query->data, "Listening"))
     {
-      std::thread([this, userID]()
-                  { this->commandQuizListening(userID); })
-          .detach();
+      userSession.randomQuiz = false;
+      commandQuizListening(userID);
     }
     else if (StringTools::startsWith(query->data, "Numerals"))
     {
-      std::thread([this, userID]()
-                  { this->commandQuizNumeralsRandomAsync(userID); })
-          .detach();
+      userSession.randomQuiz = false;
+      commandQuizNumeralsRandomAsync(userID);
+    }
+    else if (StringTools::startsWith(query->data, "Verbs"))
+    {
+      userSession.randomQuiz = false;
+      commandQuizVerbs(userID);
     }
     else if (StringTools::startsWith(query->data, "Random test"))
     {
-      std::thread([this, userID]()
-                  { this->commandQuizRandomAsync(userID); })
-          .detach();
+      userSession.randomQuiz = true;
+      commandQuizRandom(userID);
     }
     else if (StringTools::startsWith(query->data, "Stop"))
     {
-      if (userReplyStack_.find(userID) != userReplyStack_.end() && userReplyStack_[userID] == UserReply::waiting)
+      if (userSession.pagination.active())
       {
         LOG_DEBUG("User {} wants to stop\n", userID);
-        userReplyStack_[userID] = UserReply::stop;
       }
-      commandStack_.erase(userID);
-      bot_.getApi().sendMessage(userID, "Done.");
+      userSession.pagination.reset();
+      quizzes_->finish(userSession.quiz);
+      userSession.command = BotCommand::none;
+      userSession.randomQuiz = false;
+      sender_->sendMessage(userID, "Done.");
       return;
     }
     else if (StringTools::startsWith(query->data, "One more"))
     {
       LOG_DEBUG("User {} wants to continue\n", userID);
-      if (userReplyStack_.find(userID) != userReplyStack_.end() && userReplyStack_[userID] == UserReply::waiting)
+      if (userSession.pagination.active())
       {
-        LOG_DEBUG("User {} reply stack is waiting\n", userID);
-        userReplyStack_[userID] = UserReply::goon;
+        LOG_DEBUG("User {} has more results to show\n", userID);
+        showNextPage(userID);
         return;
       }
 
-      LOG_DEBUG("User {} reply stack is not waiting\n", userID);
-      if (commandStack_[userID] == BotCommand::gameKanaReading)
+      if (userSession.command == BotCommand::gameKanaReading)
       {
         LOG_DEBUG("User {} wants to continue quizKanaReading\n", userID);
-        std::thread([this, userID]()
-                    { this->commandQuizKanaReading(userID); })
-            .detach();
+        commandQuizKanaReading(userID);
       }
-      else if (commandStack_[userID] == BotCommand::gameMeaning)
+      else if (userSession.command == BotCommand::gameMeaning)
       {
         LOG_DEBUG("User {} wants to continue quizMeaning\n", userID);
-        std::thread([this, userID]()
-                    { this->commandQuizWordMeaning(userID); })
-            .detach();
+        commandQuizWordMeaning(userID);
       }
-      else if (commandStack_[userID] == BotCommand::gameReading)
+      else if (userSession.command == BotCommand::gameReading)
       {
         LOG_DEBUG("User {} wants to continue quizReading\n", userID);
-        std::thread([this, userID]()
-                    { this->commandQuizWordReading(userID); })
-            .detach();
+        commandQuizWordReading(userID);
       }
-      else if (commandStack_[userID] == BotCommand::gameAudition)
+      else if (userSession.command == BotCommand::gameAudition)
       {
         LOG_DEBUG("User {} wants to continue Audition\n", userID);
-        std::thread([this, userID]()
-                    { this->commandQuizListening(userID); })
-            .detach();
+        commandQuizListening(userID);
       }
-      else if (commandStack_[userID] == BotCommand::gameNumerals)
+      else if (userSession.command == BotCommand::gameNumerals)
       {
         LOG_DEBUG("User {} wants to continue quizNumerals\n", userID);
-        std::thread([this, userID]()
-                    { this->commandQuizNumeralsRandomAsync(userID); })
-            .detach();
+        commandQuizNumeralsRandomAsync(userID);
+      }
+      else if (userSession.command == BotCommand::gameVerbs)
+      {
+        LOG_DEBUG("User {} wants to continue quizVerbs\n", userID);
+        commandQuizVerbs(userID);
       }
       else
       {
         LOG_DEBUG("User {} wants to continue unknown command\n", userID);
-        bot_.getApi().sendMessage(userID, "Nothing to continue. Select new command.", false, 0, std::make_shared<TgBot::GenericReply>(), "Markdown");
+        sender_->sendMessage(userID, "Nothing to continue. Select new command.", nullptr, "Markdown");
       }
     }
     else
     {
-      if (commandStack_[userID] == BotCommand::gameNumerals)
+      if (userSession.command == BotCommand::gameNumerals)
       {
-        std::thread([this, query]()
-                    { this->commandQuizNumeralsCallback(query->from->id, query->data); })
-            .detach();
+        commandQuizNumeralsCallback(userID, query->data);
       }
       else
       {
@@ -134,8 +134,14 @@ namespace Bot
     }
   }
 
-  void BotCommander::handleQuizReply(TgBot::PollAnswer::Ptr answer)
+  void BotCommander::handleQuizReply(TgBot::PollAnswer::Ptr answer, QuizKind kind, int32_t correctIndex)
   {
+    if (answer->optionIds.empty())
+    {
+      LOG_DEBUG("User {} retracted the vote\n", answer->user->id);
+      return;
+    }
     LOG_DEBUG("Received reply from user {} for quiz: {}\n", answer->user->id, answer->optionIds[0]);
+    recordQuizAnswer(answer->user->id, kind, answer->optionIds[0] == correctIndex);
   }
 }
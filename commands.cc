@@ -1,6 +1,3 @@
-#include <future>
-#include <thread>
-
 #include "botcommander.hpp"
 #include "log.hpp"
 
@@ -16,6 +13,13 @@ namespace Bot
     }
 
     LOG_INFO("User {} commanded {}\n", userID, message->text);
+    session(userID).post([this, message]()
+                         { this->processCommand(message); });
+  }
+
+  void BotCommander::processCommand(const TgBot::Message::Ptr &message)
+  {
+    int64_t userID = message->from->id;
 
     // Global commands
     if (StringTools::startsWith(message->text, "/start"))
@@ -25,19 +29,7 @@ namespace Bot
     }
     if (!userManager_->userExists(userID))
     {
-      try
-      {
-        bot_.getApi().sendMessage(userID, "You are not registered. Use /start to register.");
-      }
-      catch (const TgBot::TgException &e)
-      {
-        if (StringTools::startsWith(e.what(), "Forbidden:"))
-        {
-          LOG_DEBUG("User {} has blocked the bot\n", userID);
-          return;
-        }
-      }
-
+      sender_->sendMessage(userID, "You are not registered. Use /start to register.");
       return;
     }
 
@@ -55,31 +47,25 @@ namespace Bot
     // Custom commands
     else if (StringTools::startsWith(message->text, "/search"))
     {
-      std::thread([this, message]()
-                  { this->commandSearchWord(message); })
-          .detach();
+      commandSearchWord(message);
     }
     else if (StringTools::startsWith(message->text, "/example"))
     {
-      std::thread([this, message]()
-                  { this->commandSearchExample(message); })
-          .detach();
+      commandSearchExample(message);
     }
     else if (StringTools::startsWith(message->text, "/quiz"))
     {
-      bot_.getApi().sendMessage(userID, "Choose what to train", false, 0, quizKeyboard_);
+      sender_->sendMessage(userID, "Choose what to train", quizKeyboard_);
     }
     else if (StringTools::startsWith(message->text, "/info_word"))
     {
       LOG_DEBUG("User {} wants to explain a record\n", userID);
-      std::thread([this, message]()
-                  { this->commandWordAllInfo(message); })
-          .detach();
+      commandWordAllInfo(message);
       return;
     }
     else
     {
-      bot_.getApi().sendMessage(userID, "Unknown command. /help for help.");
+      sender_->sendMessage(userID, "Unknown command. /help for help.");
     }
   }
 
@@ -95,33 +81,35 @@ namespace Bot
     int64_t chatID = message->chat->id;
     if (chatID < 0)
     {
-      bot_.getApi().sendMessage(chatID, "Groups are not supported yet.");
+      sender_->sendMessage(chatID, "Groups are not supported yet.");
       return;
     }
     LOG_DEBUG("User {} input {}\n", userID, message->text);
-    if (commandStack_.find(userID) == commandStack_.end())
+    session(userID).post([this, message]()
+                         { this->processUserInput(message); });
+  }
+
+  void BotCommander::processUserInput(const TgBot::Message::Ptr &message)
+  {
+    int64_t userID = message->from->id;
+    const BotCommand command = session(userID).command;
+    if (command == BotCommand::none)
     {
-      bot_.getApi().sendMessage(userID, "Give me a command first. Use Menu or direct commands. /help for help.");
+      sender_->sendMessage(userID, "Give me a command first. Use Menu or direct commands. /help for help.");
       return;
     }
 
-    if (commandStack_[userID] == BotCommand::searchSingleWord)
+    if (command == BotCommand::searchSingleWord)
     {
-      std::thread([this, message]()
-                  { this->commandSearchWord(message); })
-          .detach();
+      commandSearchWord(message);
     }
-    else if (commandStack_[userID] == BotCommand::searchExample)
+    else if (command == BotCommand::searchExample)
     {
-      std::thread([this, message]()
-                  { this->commandSearchExample(message); })
-          .detach();
+      commandSearchExample(message);
     }
-    else if (commandStack_[userID] == BotCommand::gameKanaReading)
+    else if (command == BotCommand::gameKanaReading)
     {
-      std::thread([this, message]()
-                  { this->commandQuizKanaReading(message); })
-          .detach();
+      commandQuizKanaReading(message);
     }
     else
     {
@@ -129,14 +117,13 @@ namespace Bot
     }
   }
 
-  void BotCommander::parseUserInputAsync(const TgBot::Message::Ptr &message)
-  {
-    auto future = std::async(std::launch::async, &BotCommander::parseUserInput, this, message);
-  }
-
   void BotCommander::parseInlineQuery(const TgBot::InlineQuery::Ptr &query)
   {
     LOG_DEBUG("User {} inline query {}\n", query->from->id, query->query);
+    UserSession &userSession = session(query->from->id);
+    const uint64_t generation = ++userSession.inlineQuery;
+    userSession.post([this, query, generation]()
+                     { answerInlineQuery(query, generation); });
   }
 
   void BotCommander::parseChosenInlineResult(const TgBot::ChosenInlineResult::Ptr &result)
@@ -1,7 +1,8 @@
 #include "botcommander.hpp"
 #include "log.hpp"
+#include "entrybatch.hpp"
+#include "messagebuilder.hpp"
 #include <algorithm>
-#include <numeric>
 namespace Bot
 {
   const BotCommander &BotCommander::commandWordAllInfo(const TgBot::Message::Ptr &query)
@@ -25,85 +26,60 @@ namespace Bot
 
     if (input.empty())
     {
-      bot_.getApi().sendMessage(userID, "No input provided.");
+      sender_->sendMessage(userID, "No input provided.");
       LOG_DEBUG("No input provided for info_word\n");
       return *this;
     }
     LOG_DEBUG("User {} wants info regarding the word {}\n", userID, input);
-    Search::SearchRequest::Ptr searchRequestUnique = std::make_unique<Search::SearchRequest>(input);
-    searchRequestUnique->enableSearchInWriting().enableSearchInGlossary().enableSearchInReading();
-    auto possibleIDs = search_->jmdict->search(std::move(searchRequestUnique));
-    if (possibleIDs.empty())
+    SearchCache::Result::Ptr result = searchCache_->find(SearchCache::Kind::wordInfo, input);
+    if (!result)
     {
-      bot_.getApi().sendMessage(userID, "No results found.");
-      LOG_DEBUG("No results found for {}\n", input);
-      return *this;
-    }
-    bot_.getApi().sendMessage(userID, std::format("Found {} results.", possibleIDs.size()));
-    uint32_t counter = 0;
-    for (const auto &id : possibleIDs)
-    {
-      if (++counter == 5)
+      if (image_)
       {
-        userReplyStack_[userID] = UserReply::waiting;
-        if (waitForUserReply(userID) == UserReply::stop)
-        {
-          return *this;
-        }
-        counter = 0;
-      }
-
-      try
-      {
-        auto glosses = search_->jmdict->gloss_by_id(id);
-        if (!glosses.empty())
-        {
-
-          std::string combinedGloss = std::accumulate(
-              glosses.begin() + 1,
-              glosses.end(),
-              glosses[0],
-              [](const std::string &lhs, const std::string &rhs)
-              {
-                return lhs + ", " + rhs;
-              });
-          bot_.getApi().sendMessage(userID, combinedGloss);
-        }
-
-        auto reads = search_->jmdict->reading_by_id(id);
-        if (!reads.empty())
-        {
-          std::string combinedReads = std::accumulate(
-              reads.begin() + 1,
-              reads.end(),
-              reads[0],
-              [](const std::string &lhs, const std::string &rhs)
-              {
-                return lhs + ", " + rhs;
-              });
-          bot_.getApi().sendMessage(userID, combinedReads);
-        }
-
-        auto writing = search_->jmdict->kanji_by_id(id);
-        if (!writing.empty())
-        {
-          std::string combinedWriting = std::accumulate(
-              writing.begin() + 1,
-              writing.end(),
-              writing[0],
-              [](const std::string &lhs, const std::string &rhs)
-              {
-                return lhs + ", " + rhs;
-              });
-          bot_.getApi().sendMessage(userID, combinedWriting);
-        }
+        result = searchCache_->insert(SearchCache::Kind::wordInfo, input, searchWords(input));
       }
-      catch (const std::exception &e)
+      else
       {
-        LOG_EXCEPTION("Exception while searching", e);
+        Search::SearchRequest::Ptr searchRequestUnique = std::make_unique<Search::SearchRequest>(input);
+        searchRequestUnique->enableSearchInWriting().enableSearchInGlossary().enableSearchInReading();
+        result = searchCache_->insert(SearchCache::Kind::wordInfo, input, dictionary().jmdict->search(std::move(searchRequestUnique)));
       }
     }
-    LOG_DEBUG("Search for {} finished\n", query->text);
+    if (result->ids().empty())
+    {
+      sender_->sendMessage(userID, "No results found.");
+      LOG_DEBUG("No results found for {}\n", input);
+      return *this;
+    }
+    sender_->sendMessage(userID, std::format("Found {} results.", result->ids().size()));
+    paginate(userID, result->ids().size(), [this, userID, result](size_t index)
+             {
+      const std::string &info = result->line(index, [this](std::span<const uint32_t> ids)
+                                             { return renderWordInfo(ids); });
+      if (!info.empty())
+      {
+        sender_->sendMessage(userID, info);
+      } });
+    LOG_DEBUG("Search for {} returned its first page\n", query->text);
     return *this;
   }
+
+  // Glosses, readings and writings, one comma separated line each
+  std::vector<std::string> BotCommander::renderWordInfo(std::span<const uint32_t> ids)
+  {
+    std::vector<std::string> lines(ids.size());
+    visitEntries(ids, [&lines](size_t entry, const auto &writings, const auto &readings, const auto &glosses)
+                 {
+                   MessageBuilder line;
+                   for (const auto *values : {&glosses, &readings, &writings})
+                   {
+                     if (!values->empty() && !line.empty())
+                     {
+                       line.raw('\n');
+                     }
+                     line.join(*values, ", ");
+                   }
+                   lines[entry] = line.str(); });
+    return lines;
+  }
 }
\ No newline at end of file
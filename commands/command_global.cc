@@ -7,14 +7,14 @@ namespace Bot
   {
     if (userManager_->userExists(userId))
     {
-      bot_.getApi().sendMessage(userId, "You've already registered.");
+      sender_->sendMessage(userId, "You've already registered.");
       LOG_INFO("User {} already exists\n", userId);
     }
     else
     {
       userManager_->createUserEntry(userId);
       LOG_INFO("User {} created\n", userId);
-      bot_.getApi().sendMessage(userId, "The entry for you has been created.");
+      sender_->sendMessage(userId, "The entry for you has been created.");
     }
     return *this;
   }
@@ -22,14 +22,14 @@ namespace Bot
   const BotCommander &BotCommander::help(int64_t userId)
   {
     std::string response = "Available commands:\n";
-    bot_.getApi().sendMessage(userId, response);
+    sender_->sendMessage(userId, response);
     return *this;
   }
 
   const BotCommander &BotCommander::settings(int64_t userId)
   {
     LOG_DEBUG("User {} wants to change settings\n", userId);
-    bot_.getApi().sendMessage(userId, "Not implemented yet.");
+    sender_->sendMessage(userId, "Not implemented yet.");
     return *this;
   }
 
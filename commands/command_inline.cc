@@ -0,0 +1,144 @@
+#include "botcommander.hpp"
+#include "log.hpp"
+#include "transliteration.hpp"
+
+#include <chrono>
+
+namespace
+{
+  constexpr size_t MAX_INLINE_RESULTS = 20;
+  // How long Telegram may reuse an answer for the same query text
+  constexpr int32_t INLINE_CACHE_SECONDS = 300;
+}
+
+namespace Bot
+{
+  void BotCommander::buildSuggestions()
+  {
+    const auto started = std::chrono::steady_clock::now();
+    SuggestionIndex::Builder builder;
+    std::string romaji;
+    // Gloss phrases are also reachable from the start of each of their words
+    auto glossKeys = [&builder](uint32_t suggestion, std::string_view gloss)
+    {
+      const std::string normalized = SearchCache::normalize(gloss);
+      const std::string_view key(normalized);
+      builder.key(suggestion, key);
+      for (size_t space = key.find(' '); space != std::string_view::npos; space = key.find(' ', space + 1))
+      {
+        builder.key(suggestion, key.substr(space + 1));
+      }
+    };
+
+    if (image_)
+    {
+      for (uint32_t entry = 0; entry < image_->size(); ++entry)
+      {
+        const auto writings = image_->values(entry, DictImage::writing);
+        const auto readings = image_->values(entry, DictImage::reading);
+        const auto glosses = image_->values(entry, DictImage::gloss);
+        if (readings.empty())
+        {
+          continue;
+        }
+        const std::string_view reading = image_->string(readings.front());
+        const uint32_t suggestion = builder.add(writings.empty() ? reading : image_->string(writings.front()),
+                                                reading, glosses.empty() ? std::string_view() : image_->string(glosses.front()));
+        for (const auto &writing : writings)
+        {
+          builder.key(suggestion, image_->string(writing));
+        }
+        for (const auto &value : readings)
+        {
+          builder.key(suggestion, image_->string(value));
+          builder.key(suggestion, Kana::toRomaji(image_->string(value), romaji));
+        }
+        for (const auto &gloss : glosses)
+        {
+          glossKeys(suggestion, image_->string(gloss));
+        }
+      }
+    }
+    else if (const QuestionBank::Level *level = quizLevel(0, QuestionBank::DEFAULT_LEVEL))
+    {
+      // Without an image only the JLPT vocabulary can be suggested
+      for (uint32_t word = 0; word < level->size(); ++word)
+      {
+        const auto readings = level->readings(word);
+        const auto glosses = level->glosses(word);
+        const uint32_t suggestion = builder.add(level->word(word), readings.front(), glosses.front());
+        builder.key(suggestion, level->word(word));
+        for (const std::string_view reading : readings)
+        {
+          builder.key(suggestion, reading);
+          builder.key(suggestion, Kana::toRomaji(reading, romaji));
+        }
+        for (const std::string_view gloss : glosses)
+        {
+          glossKeys(suggestion, gloss);
+        }
+      }
+    }
+
+    suggestionIndex_ = builder.build();
+    suggestions_.store(suggestionIndex_.get(), std::memory_order_release);
+    const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+    LOG_INFO("Inline suggestions built in {}ms: {} words, {} keys, {} bytes\n",
+             elapsedMs, suggestionIndex_->size(), suggestionIndex_->keys(), suggestionIndex_->memoryUsage());
+  }
+
+  void BotCommander::answerInlineQuery(const TgBot::InlineQuery::Ptr &query, uint64_t generation)
+  {
+    UserSession &userSession = session(query->from->id);
+    // The user kept typing while this one waited, Telegram has dropped it already
+    if (userSession.inlineQuery != generation)
+    {
+      staleInlineQueries_++;
+      return;
+    }
+    const SuggestionIndex *suggestions = suggestions_.load(std::memory_order_acquire);
+    if (!suggestions)
+    {
+      LOG_DEBUG("Inline suggestions are not ready yet\n");
+      return;
+    }
+
+    const std::string prefix = SearchCache::normalize(query->query);
+    SearchCache::Result::Ptr found = searchCache_->find(SearchCache::Kind::suggestion, prefix);
+    if (!found)
+    {
+      found = searchCache_->insert(SearchCache::Kind::suggestion, prefix, suggestions->find(prefix, MAX_INLINE_RESULTS));
+    }
+
+    std::vector<TgBot::InlineQueryResult::Ptr> results;
+    results.reserve(found->ids().size());
+    for (uint32_t index : found->ids())
+    {
+      const SuggestionIndex::Suggestion suggestion = suggestions->suggestion(index);
+      auto content = std::make_shared<TgBot::InputTextMessageContent>();
+      content->messageText = suggestion.title == suggestion.reading
+                                 ? std::format("{}: {}", suggestion.title, suggestion.gloss)
+                                 : std::format("{} ({}): {}", suggestion.title, suggestion.reading, suggestion.gloss);
+      auto article = std::make_shared<TgBot::InlineQueryResultArticle>();
+      article->id = std::to_string(index);
+      article->title = suggestion.title;
+      article->description = suggestion.title == suggestion.reading ? std::string(suggestion.gloss) : std::format("{} {}", suggestion.reading, suggestion.gloss);
+      article->inputMessageContent = content;
+      results.push_back(article);
+    }
+
+    if (userSession.inlineQuery != generation)
+    {
+      staleInlineQueries_++;
+      return;
+    }
+    try
+    {
+      bot_.getApi().answerInlineQuery(query->id, results, INLINE_CACHE_SECONDS);
+    }
+    catch (const TgBot::TgException &e)
+    {
+      LOG_EXCEPTION("Exception while answering an inline query", e);
+    }
+  }
+}
\ No newline at end of file
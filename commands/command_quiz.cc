@@ -20,66 +20,41 @@ namespace Bot
     return false;
   }
 
-  int findMatchingIndex(const std::vector<std::string> &where, const std::string &what)
-  {
-    for (size_t i = 0; i < where.size(); ++i)
-    {
-      if (where[i] == what)
-      {
-        return i;
-      }
-    }
-    return -1;
-  }
-
-  void BotCommander::commandQuizRandomAsync(int64_t userID)
-  {
-    auto future = std::async(std::launch::async, &BotCommander::commandQuizRandom, this, userID);
-  }
-
   const BotCommander &BotCommander::commandQuizRandom(int64_t userID)
   {
     LOG_DEBUG("User {} wants to train random quiz\n", userID);
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 5);
+    std::uniform_int_distribution<> dis(0, 6);
     int choice = dis(gen);
     LOG_DEBUG("Random choice: {}\n", choice);
     if (choice == 0)
     {
-      std::thread([this, userID]()
-                  { this->commandQuizWordMeaning(userID); })
-          .detach();
+      commandQuizWordMeaning(userID);
     }
     else if (choice == 1)
     {
-      std::thread([this, userID]()
-                  { this->commandQuizKanaReading(userID); })
-          .detach();
+      commandQuizKanaReading(userID);
     }
     else if (choice == 2)
     {
-      std::thread([this, userID]()
-                  { this->commandQuizWordReading(userID); })
-          .detach();
+      commandQuizWordReading(userID);
     }
     else if (choice == 3)
     {
-      std::thread([this, userID]()
-                  { this->commandQuizJapaneseNumerals(userID); })
-          .detach();
+      commandQuizJapaneseNumerals(userID);
     }
     else if (choice == 4)
     {
-      std::thread([this, userID]()
-                  { this->commandQuizNumeralCounters(userID); })
-          .detach();
+      commandQuizNumeralCounters(userID);
     }
     else if (choice == 5)
     {
-      std::thread([this, userID]()
-                  { this->commandQuizListening(userID); })
-          .detach();
+      commandQuizListening(userID);
+    }
+    else if (choice == 6)
+    {
+      commandQuizVerbs(userID);
     }
     return *this;
   }
@@ -1,5 +1,61 @@
 #include "../botcommander.hpp"
+#include "entrybatch.hpp"
+#include "inflection.hpp"
+#include "levenshtein.hpp"
 #include "log.hpp"
+#include "messagebuilder.hpp"
+#include "transliteration.hpp"
+
+#include <array>
+#include <unordered_set>
+
+namespace
+{
+  enum MatchRank
+  {
+    exactMatch,
+    prefixMatch,
+    substringMatch,
+    unranked,
+    matchRanks,
+  };
+
+  // Candidates past this many keep the dictionary's order behind the ranked ones
+  constexpr size_t MAX_RANKED_CANDIDATES = 256;
+  // Per index lookup, a one letter prefix would otherwise match a good part of the dictionary
+  constexpr size_t MAX_IMAGE_MATCHES = 1000;
+  // Closest keys a search with no results tries, in order, before giving up
+  constexpr size_t MAX_FUZZY_CANDIDATES = 5;
+  // Longer queries are sentences, not typos
+  constexpr size_t MAX_FUZZY_QUERY = 128;
+  // Dictionary forms a search with no results looks up, fewest deinflection steps first
+  constexpr size_t MAX_DEINFLECTIONS = 32;
+
+  // One edit per three characters up to the configured limit, a typo in a
+  // very short word is more likely another word
+  unsigned fuzzyEdits(std::string_view query, size_t maxEdits)
+  {
+    size_t length = 0;
+    for (size_t pos = 0; pos < query.size(); length++)
+    {
+      Bot::nextCodePoint(query, pos);
+    }
+    return static_cast<unsigned>(std::min(maxEdits, length / 3));
+  }
+
+  MatchRank rankField(std::string_view field, std::string_view query)
+  {
+    if (query.empty())
+      return unranked;
+    if (field == query)
+      return exactMatch;
+    if (field.starts_with(query))
+      return prefixMatch;
+    if (field.find(query) != std::string_view::npos)
+      return substringMatch;
+    return unranked;
+  }
+}
 
 namespace Bot
 {
@@ -7,9 +63,10 @@ namespace Bot
   {
     LOG_DEBUG("User {} wants to search for a word\n", query->chat->id);
     int64_t userID = query->chat->id;
-    commandStack_[userID] = BotCommand::searchSingleWord;
+    session(userID).command = BotCommand::searchSingleWord;
     const std::string searchActionStr = "typing";
-    bot_.getApi().sendChatAction(userID, searchActionStr);
+    sender_->post(userID, [this, userID, searchActionStr]()
+                  { bot_.getApi().sendChatAction(userID, searchActionStr); });
     std::string input = "";
     if (!query->text.empty() && query->text[0] == '/')
       input = getStringToken(query->text, 2);
@@ -18,82 +75,330 @@ namespace Bot
 
     if (input.empty())
     {
-      bot_.getApi().sendMessage(userID, "Enter a word to search for.");
+      sender_->sendMessage(userID, "Enter a word to search for.");
       LOG_DEBUG("No input provided for search_word\n");
       return *this;
     }
 
-    Search::SearchRequest::Ptr searchRequestUnique = std::make_unique<Search::SearchRequest>(input);
-    searchRequestUnique->enableSearchInGlossary();
-    std::vector<uint32_t> possibleIDs;
-    // First try to search in glossary
-    auto ids = search_->jmdict->search(std::move(searchRequestUnique));
-    possibleIDs.insert(possibleIDs.end(), ids.begin(), ids.end());
-
-    // May be it's in Japanese?
-    searchRequestUnique = std::make_unique<Search::SearchRequest>(input);
-    searchRequestUnique->enableSearchInWriting().enableSearchInReading();
-    ids = search_->jmdict->search(std::move(searchRequestUnique));
-    possibleIDs.insert(possibleIDs.end(), ids.begin(), ids.end());
+    SearchCache::Result::Ptr result = searchCache_->find(SearchCache::Kind::word, input);
+    if (!result)
+    {
+      result = searchCache_->insert(SearchCache::Kind::word, input, searchWords(input));
+    }
+    std::string correction;
+    if (result->ids().empty())
+    {
+      if (SearchCache::Result::Ptr corrected = searchFuzzy(input, correction))
+      {
+        result = std::move(corrected);
+      }
+    }
+    if (result->ids().empty())
+    {
+      sender_->sendMessage(userID, "No results found.");
+      LOG_DEBUG("No results found for {}\n", input);
+      return *this;
+    }
+
+    if (!correction.empty())
+    {
+      sender_->sendMessage(userID, std::format("Nothing found for {}. Showing results for {}.", input, correction));
+      LOG_DEBUG("Search for {} corrected to {}\n", input, correction);
+    }
+    sender_->sendMessage(userID, std::format("Found {} results.", result->ids().size()));
+    paginate(userID, result->ids().size(), [this, userID, result](size_t index)
+             {
+      const std::string &line = result->line(index, [this](std::span<const uint32_t> ids)
+                                             { return renderWords(ids); });
+      if (!line.empty())
+      {
+        sender_->sendMessage(userID, line, nullptr, "Markdown");
+      } });
+    LOG_DEBUG("Search for {} returned its first page\n", input);
+    return *this;
+  }
 
+  // Nothing matched the input as typed: the closest keys of the suggestion
+  // index are searched instead, best first, until one finds something. The
+  // keys are dictionary keys, so they are only looked up, never deinflected.
+  SearchCache::Result::Ptr BotCommander::searchFuzzy(const std::string &input, std::string &correction)
+  {
+    const SuggestionIndex *suggestions = suggestions_.load(std::memory_order_acquire);
+    const std::string query = SearchCache::normalize(input);
+    const unsigned edits = fuzzyEdits(query, fuzzyEdits_);
+    if (!suggestions || !edits || query.size() > MAX_FUZZY_QUERY)
+    {
+      return nullptr;
+    }
+    fuzzySearches_++;
+    for (const auto &match : suggestions->fuzzy(query, edits, MAX_FUZZY_CANDIDATES))
+    {
+      const std::string key(match.key);
+      SearchCache::Result::Ptr result = searchCache_->find(SearchCache::Kind::correction, key);
+      if (!result)
+      {
+        result = searchCache_->insert(SearchCache::Kind::correction, key, searchCorrected(key));
+      }
+      if (!result->ids().empty())
+      {
+        fuzzyCorrected_++;
+        correction = key;
+        return result;
+      }
+    }
+    return nullptr;
+  }
+
+  // Glossary, writing and reading are searched in one request, plus the
+  // romaji form of the input when it differs. Hits are deduplicated and
+  // ranked exact > prefix > substring; ranking stops as soon as a full first
+  // page of exact matches is found.
+  std::vector<uint32_t> BotCommander::searchWords(const std::string &input)
+  {
+    const std::string query = SearchCache::normalize(input);
+    if (image_)
+    {
+      // The image indexes kana readings only, neko is looked up as ねこ
+      std::string kana;
+      Kana::fromRomaji(input, kana);
+      std::vector<uint32_t> result = searchImage(query, input, kana);
+      return result.empty() ? searchDeinflected(input) : result;
+    }
+
+    std::string romaji;
+    Kana::toRomaji(input, romaji);
+
+    std::vector<uint32_t> candidates;
+    std::unordered_set<uint32_t> seen;
+    auto collect = [&](Search::SearchRequest::Ptr request)
+    {
+      for (uint32_t id : dictionary().jmdict->search(std::move(request)))
+      {
+        if (seen.insert(id).second)
+        {
+          candidates.push_back(id);
+        }
+      }
+    };
+
+    Search::SearchRequest::Ptr searchRequestUnique = std::make_unique<Search::SearchRequest>(input);
+    searchRequestUnique->enableSearchInGlossary().enableSearchInWriting().enableSearchInReading();
+    collect(std::move(searchRequestUnique));
     // Maybe it's a romaji?
-    std::string romaji = KanaProc::toRomaji(input);
     if (romaji != input)
     {
       searchRequestUnique = std::make_unique<Search::SearchRequest>(romaji);
       searchRequestUnique->enableSearchInWriting().enableSearchInReading();
-      ids = search_->jmdict->search(std::move(searchRequestUnique));
+      collect(std::move(searchRequestUnique));
+    }
+    if (candidates.empty())
+    {
+      return searchDeinflected(input);
+    }
 
-      possibleIDs.insert(possibleIDs.end(), ids.begin(), ids.end());
+    // Fetched a page at a time so that ranking can stop after the first one
+    std::array<std::vector<uint32_t>, matchRanks> ranked;
+    size_t next = 0;
+    while (next < std::min(candidates.size(), MAX_RANKED_CANDIDATES) && ranked[exactMatch].size() < RESULTS_PER_PAGE)
+    {
+      const std::span<const uint32_t> page = std::span<const uint32_t>(candidates).subspan(next, std::min(RESULTS_PER_PAGE, candidates.size() - next));
+      visitEntries(page, [&](size_t entry, const auto &writings, const auto &readings, const auto &glosses)
+                   {
+                     MatchRank best = unranked;
+                     for (const std::string_view gloss : glosses)
+                     {
+                       best = std::min(best, rankField(SearchCache::normalize(gloss), query));
+                     }
+                     for (const auto *values : {&writings, &readings})
+                     {
+                       for (const std::string_view value : *values)
+                       {
+                         best = std::min({best, rankField(value, input), rankField(value, romaji)});
+                       }
+                     }
+                     ranked[best].push_back(page[entry]); });
+      next += page.size();
     }
-    if (possibleIDs.empty())
+    // The ranked candidates take the place of the first next ones, the rest keep their order
+    auto out = candidates.begin();
+    for (const auto &ids : ranked)
     {
-      bot_.getApi().sendMessage(userID, "No results found.");
-      LOG_DEBUG("No results found for {}\n", input);
-      return *this;
+      out = std::copy(ids.begin(), ids.end(), out);
+    }
+    LOG_DEBUG("Search for {}: {} results, {} ranked\n", input, candidates.size(), next);
+    return candidates;
+  }
+
+  // A suggestion key: a writing, a reading, a gloss or its words, or the
+  // romaji of a reading, which is looked up as the kana it spells
+  std::vector<uint32_t> BotCommander::searchCorrected(const std::string &key)
+  {
+    std::string kana;
+    Kana::fromRomaji(key, kana);
+    if (image_)
+    {
+      return searchImage(SearchCache::normalize(key), key, kana);
     }
 
-    bot_.getApi().sendMessage(userID, std::format("Found {} results.", possibleIDs.size()));
-    uint32_t counter = 0;
-    for (const auto &id : possibleIDs)
+    std::vector<uint32_t> result;
+    std::unordered_set<uint32_t> seen;
+    auto collect = [&](Search::SearchRequest::Ptr request)
     {
-      if (++counter == 5)
+      for (uint32_t id : dictionary().jmdict->search(std::move(request)))
       {
-        userReplyStack_[userID] = UserReply::waiting;
-        if (waitForUserReply(userID) == UserReply::stop)
+        if (seen.insert(id).second)
         {
-          return *this;
+          result.push_back(id);
         }
-        counter = 0;
       }
+    };
+    Search::SearchRequest::Ptr request = std::make_unique<Search::SearchRequest>(key);
+    request->enableSearchInGlossary().enableSearchInWriting().enableSearchInReading();
+    collect(std::move(request));
+    if (kana != key)
+    {
+      request = std::make_unique<Search::SearchRequest>(kana);
+      request->enableSearchInWriting().enableSearchInReading();
+      collect(std::move(request));
+    }
+    return result;
+  }
 
-      try
+  // Same ranking from the image's sorted indices: exact keys first, then
+  // prefixes, then glosses containing the query as a word. alternate is
+  // another spelling of input looked up the same way, its romaji or kana.
+  std::vector<uint32_t> BotCommander::searchImage(const std::string &query, const std::string &input, const std::string &alternate)
+  {
+    std::vector<uint32_t> result;
+    std::unordered_set<uint32_t> seen;
+    std::vector<uint32_t> hits;
+    auto lookup = [&](DictionaryImage::Index index, const std::string &key, bool prefix)
+    {
+      if (key.empty())
+      {
+        return;
+      }
+      hits.clear();
+      image_->search(index, key, prefix, hits, MAX_IMAGE_MATCHES);
+      for (uint32_t id : hits)
       {
-        auto writing = search_->jmdict->kanji_by_id(id);
-        auto reads = search_->jmdict->reading_by_id(id);
-        auto glosses = search_->jmdict->gloss_by_id(id);
+        if (seen.insert(id).second)
+        {
+          result.push_back(id);
+        }
+      }
+    };
 
-        std::string result = std::format("*{}* _{}_ {} `{}` ...",
-                                         !writing.empty() ? writing.front() : reads.front(),
-                                         !writing.empty() ? reads.front() : "",
-                                         KanaProc::toRomaji(reads.front()),
-                                         glosses.front());
+    for (const bool prefix : {false, true})
+    {
+      lookup(DictionaryImage::Index::writing, input, prefix);
+      lookup(DictionaryImage::Index::reading, input, prefix);
+      if (alternate != input)
+      {
+        lookup(DictionaryImage::Index::writing, alternate, prefix);
+        lookup(DictionaryImage::Index::reading, alternate, prefix);
+      }
+      lookup(DictionaryImage::Index::gloss, query, prefix);
+    }
+    lookup(DictionaryImage::Index::glossWord, query, false);
+    LOG_DEBUG("Search for {} in the image: {} results\n", input, result.size());
+    return result;
+  }
 
-        bot_.getApi().sendMessage(query->chat->id, result, false, 0, std::make_shared<TgBot::GenericReply>(), "Markdown");
+  // Only dictionary forms are indexed: 食べました or tabenakatta are looked
+  // up as every form they may inflect from, all in one batch. Results keep
+  // the order of the deinflections, so the fewest steps come first.
+  std::vector<uint32_t> BotCommander::searchDeinflected(const std::string &input)
+  {
+    std::string kana;
+    const std::string_view text = Kana::fromRomaji(input, kana);
+    // Romaji counts only when all of it spells kana, English and anything
+    // else left over in ASCII has no Japanese endings to strip
+    if (std::any_of(text.begin(), text.end(), [](char c)
+                    { return static_cast<unsigned char>(c) < 0x80; }))
+    {
+      return {};
+    }
+    const std::vector<Inflection::Deinflection> deinflections = Inflection::deinflect(text);
+    std::vector<std::string_view> keys;
+    auto key = [&keys](std::string_view word)
+    {
+      if (!word.empty() && keys.size() < MAX_DEINFLECTIONS && std::find(keys.begin(), keys.end(), word) == keys.end())
+      {
+        keys.push_back(word);
       }
-      catch (const std::exception &e)
+    };
+    for (const Inflection::Deinflection &deinflection : deinflections)
+    {
+      key(deinflection.word);
+      // 勉強する is listed as the noun 勉強
+      if (deinflection.wordClass == Inflection::suru)
       {
-        LOG_EXCEPTION("Exception while searching", e);
+        key(std::string_view(deinflection.word).substr(0, deinflection.word.size() - std::string_view("する").size()));
       }
     }
-    LOG_DEBUG("Search for {} finished\n", input);
-    return *this;
+
+    std::vector<uint32_t> result;
+    std::unordered_set<uint32_t> seen;
+    if (image_)
+    {
+      std::vector<std::pair<uint32_t, uint32_t>> hits;
+      image_->search(DictionaryImage::Index::writing, keys, hits, MAX_IMAGE_MATCHES);
+      image_->search(DictionaryImage::Index::reading, keys, hits, MAX_IMAGE_MATCHES);
+      std::stable_sort(hits.begin(), hits.end(), [](const auto &a, const auto &b)
+                       { return a.first < b.first; });
+      for (const auto &[key, id] : hits)
+      {
+        if (seen.insert(id).second)
+        {
+          result.push_back(id);
+        }
+      }
+    }
+    else
+    {
+      for (const std::string_view word : keys)
+      {
+        Search::SearchRequest::Ptr request = std::make_unique<Search::SearchRequest>(std::string(word));
+        request->enableSearchInWriting().enableSearchInReading();
+        for (uint32_t id : dictionary().jmdict->search(std::move(request)))
+        {
+          if (seen.insert(id).second)
+          {
+            result.push_back(id);
+          }
+        }
+      }
+    }
+    LOG_DEBUG("Search for {} as {} dictionary forms: {} results\n", input, keys.size(), result.size());
+    return result;
+  }
+
+  std::vector<std::string> BotCommander::renderWords(std::span<const uint32_t> ids)
+  {
+    std::vector<std::string> lines(ids.size());
+    visitEntries(ids, [&](size_t entry, const auto &writings, const auto &readings, const auto &glosses)
+                 {
+                   if (readings.empty() || glosses.empty())
+                   {
+                     LOG_DEBUG("Entry {} has no reading or gloss\n", ids[entry]);
+                     return;
+                   }
+                   const std::string_view writing = writings.empty() ? std::string_view() : std::string_view(writings.front());
+                   const std::string_view reading = readings.front();
+                   MessageBuilder line;
+                   line.raw('*').raw(!writing.empty() ? writing : reading).raw("* _").raw(!writing.empty() ? reading : "").raw("_ ");
+                   line.write(Kana::maxRomajiSize(reading.size()), [reading](std::span<char> out)
+                              { return Kana::toRomaji(reading, out); });
+                   line.raw(" `").raw(glosses.front()).raw("` ...");
+                   lines[entry] = line.str(); });
+    return lines;
   }
 
   const BotCommander &BotCommander::commandSearchExample(const TgBot::Message::Ptr &query)
   {
     int64_t userID = query->chat->id;
-    commandStack_[query->chat->id] = BotCommand::searchExample;
+    session(userID).command = BotCommand::searchExample;
     std::string input = "";
     if (!query->text.empty() && query->text[0] == '/')
       input = getStringToken(query->text, 2);
@@ -101,42 +406,44 @@ namespace Bot
       input = getStringToken(query->text, 1);
     LOG_DEBUG("User {} wants to search for usage examples\n", userID);
     const std::string searchActionStr = "typing";
-    bot_.getApi().sendChatAction(userID, searchActionStr);
-    Search::SearchRequest::Ptr searchRequestUnique = std::make_unique<Search::SearchRequest>();
-    searchRequestUnique->enableSearchInExamples();
-    searchRequestUnique->setSearchQuery(input);
-    auto possibleIDs = search_->example->search(std::move(searchRequestUnique));
-    if (possibleIDs.empty())
-    {
-      bot_.getApi().sendMessage(userID, "Enter a word to search for in usage examples.");
+    sender_->post(userID, [this, userID, searchActionStr]()
+                  { bot_.getApi().sendChatAction(userID, searchActionStr); });
+    SearchCache::Result::Ptr result = searchCache_->find(SearchCache::Kind::example, input);
+    if (!result)
+    {
+      Search::SearchRequest::Ptr searchRequestUnique = std::make_unique<Search::SearchRequest>();
+      searchRequestUnique->enableSearchInExamples();
+      searchRequestUnique->setSearchQuery(input);
+      result = searchCache_->insert(SearchCache::Kind::example, input, dictionary().example->search(std::move(searchRequestUnique)));
+    }
+    if (result->ids().empty())
+    {
+      sender_->sendMessage(userID, "Enter a word to search for in usage examples.");
       LOG_DEBUG("No input provided for search_example\n");
       return *this;
     }
 
-    uint32_t counter = 0;
-    for (const auto &id : possibleIDs)
-    {
-      if (++counter == 5)
-      {
-        userReplyStack_[userID] = UserReply::waiting;
-        if (waitForUserReply(userID) == UserReply::stop)
-        {
-          return *this;
-        }
-        counter = 0;
-      }
+    paginate(userID, result->ids().size(), [this, userID, result](size_t index)
+             { sender_->sendMessage(userID, result->line(index, [this](std::span<const uint32_t> ids)
+                                                         { return renderExamples(ids); })); });
+    LOG_DEBUG("Search for {} returned its first page\n", input);
+    return *this;
+  }
 
-      std::string result;
-      auto example = search_->example->tatoeba_example(id);
-      auto translation = search_->example->tatoeba_translation_eng(id);
-      result += example;
-      result += "\r\n";
+  std::vector<std::string> BotCommander::renderExamples(std::span<const uint32_t> ids)
+  {
+    std::vector<std::string> lines;
+    lines.reserve(ids.size());
+    for (uint32_t id : ids)
+    {
+      auto example = dictionary().example->tatoeba_example(id);
+      auto translation = dictionary().example->tatoeba_translation_eng(id);
+      MessageBuilder line;
+      line.raw(example).raw("\r\n");
       if (!translation.empty())
-        result += translation.front();
-
-      bot_.getApi().sendMessage(userID, result);
+        line.raw(translation.front());
+      lines.push_back(line.str());
     }
-    LOG_DEBUG("Search for {} finished\n", input);
-    return *this;
+    return lines;
   }
 }
\ No newline at end of file
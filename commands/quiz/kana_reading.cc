@@ -5,57 +5,74 @@
 #include "botcommander.hpp"
 #include "metrics/profiler.hpp"
 #include "log.hpp"
+#include "transliteration.hpp"
 
 namespace Bot
 {
   const BotCommander &BotCommander::commandQuizKanaReading(TgBot::Message::Ptr message)
   {
     RECORD_CALL();
-    std::string correctAnswer = KanaProc::toRomaji(quizRandomKana_);
-    std::string userAnswerRomaji = KanaProc::toRomaji(KanaProc::fromRomaji(message->text));
-    LOG_DEBUG("User thinks that {} reads as {}\n", quizRandomKana_, message->text);
+    UserSession &userSession = session(message->from->id);
+    const KanaQuiz *quiz = quizzes_->find<KanaQuiz>(userSession.quiz);
+    if (!quiz)
+    {
+      sender_->sendMessage(message->chat->id, "This question is over. Continue?", continueKeyboard_);
+      return *this;
+    }
+    const std::string_view kana = quiz->kana;
+    quizzes_->finish(userSession.quiz);
+    // Both sides are spelled by the same tables, so kana, Hepburn and Kunrei
+    // answers compare equal
+    std::string correctBuffer, kanaBuffer, answerBuffer;
+    const std::string_view correctAnswer = Kana::toRomaji(kana, correctBuffer);
+    const std::string_view userAnswerRomaji = Kana::toRomaji(Kana::fromRomaji(message->text, kanaBuffer), answerBuffer);
+    LOG_DEBUG("User thinks that {} reads as {}\n", kana, message->text);
     LOG_DEBUG("{} ==> {}\n", correctAnswer, userAnswerRomaji);
 
+    recordQuizAnswer(message->from->id, QuizKind::kanaReading, correctAnswer == userAnswerRomaji);
     if (correctAnswer == userAnswerRomaji)
     {
-      bot_.getApi().sendMessage(message->chat->id, "*Correct!*", false, 0, std::make_shared<TgBot::GenericReply>(), "Markdown");
+      sender_->sendMessage(message->chat->id, "*Correct!*", nullptr, "Markdown");
     }
     else
     {
-      bot_.getApi().sendMessage(message->chat->id, std::format("*Wrong!* It reads as *{}*", correctAnswer), false, 0, std::make_shared<TgBot::GenericReply>(), "Markdown");
+      sender_->sendMessage(message->chat->id, std::format("*Wrong!* It reads as *{}*", correctAnswer), nullptr, "Markdown");
     }
-    bot_.getApi().sendMessage(message->chat->id, "Continue?", false, 0, continueKeyboard_);
-    commandStack_[message->chat->id] = BotCommand::gameKanaReading;
+    sender_->sendMessage(message->chat->id, "Continue?", continueKeyboard_);
+    userSession.command = BotCommand::gameKanaReading;
     return *this;
   }
 
   const BotCommander &BotCommander::commandQuizKanaReading(int64_t userID)
   {
     LOG_DEBUG("User {} wants to train kana reading\n", userID);
-    bot_.getApi().sendDice(userID, false, 0, std::make_shared<TgBot::GenericReply>(), "🎲", "Markdown");
-    Training::JlptTraining::Ptr training;
-    try
+    sender_->post(userID, [this, userID]()
+                  { bot_.getApi().sendDice(userID, false, 0, std::make_shared<TgBot::GenericReply>(), "🎲", "Markdown"); });
+    const QuestionBank::Level *level = quizLevel(userID, QuestionBank::QUIZ_LEVEL);
+    if (!level)
     {
-      training = std::make_unique<Training::JlptTraining>(5);
-    }
-    catch (const std::runtime_error &e)
-    {
-      bot_.getApi().sendMessage(userID, std::format("Error: {}", e.what()));
-      LOG_DEBUG("Error: {}\n", e.what());
       return *this;
     }
 
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_int_distribution<> intDist(3, 8);
-    std::uniform_real_distribution<float> floatDist(0.0, 1.0);
-    int randomInt = intDist(gen);
-    float randomFloat = floatDist(gen);
-    quizRandomKana_ = training->getRandomKanaWord(randomInt, randomFloat);
-    std::string question = std::format("Can you read it? *{}*. _Repeat it in romaji_", quizRandomKana_);
-    bot_.getApi().sendMessage(userID, question, false, 0, std::make_shared<TgBot::GenericReply>(), "Markdown");
+    std::uniform_int_distribution<size_t> intDist(QuestionBank::MIN_KANA_LENGTH, QuestionBank::MAX_KANA_LENGTH);
+    UserSession &userSession = session(userID);
+    const std::string_view kana = level->randomKanaWord(intDist(gen));
+    if (kana.empty())
+    {
+      LOG_DEBUG("Couldn't get random kana word\n");
+      return *this;
+    }
+    if (!quizzes_->start(userID, userSession.quiz, KanaQuiz{kana}))
+    {
+      sender_->sendMessage(userID, "Too many quizzes are running right now, please try again in a minute.");
+      return *this;
+    }
+    std::string question = std::format("Can you read it? *{}*. _Repeat it in romaji_", kana);
+    sender_->sendMessage(userID, question, nullptr, "Markdown");
     LOG_DEBUG("Finished quiz kana reading\n");
-    commandStack_[userID] = BotCommand::gameKanaReading;
+    userSession.command = BotCommand::gameKanaReading;
 
     return *this;
   }
@@ -5,6 +5,7 @@
 #include "botcommander.hpp"
 #include "metrics/profiler.hpp"
 #include "log.hpp"
+#include "messagebuilder.hpp"
 
 namespace Bot
 {
@@ -12,19 +13,13 @@ namespace Bot
   {
     LOG_DEBUG("User {} wants to train a listening\n", userID);
 
-    Training::JlptTraining::Ptr training;
-    try
+    const QuestionBank::Level *level = quizLevel(userID, QuestionBank::DEFAULT_LEVEL);
+    if (!level)
     {
-      training = std::make_unique<Training::JlptTraining>();
-    }
-    catch (const std::runtime_error &e)
-    {
-      bot_.getApi().sendMessage(userID, std::format("Error: {}", e.what()));
-      LOG_DEBUG("Error: {}\n", e.what());
       return *this;
     }
 
-    uint32_t exampleID = training->getRandomAudioExampleIDForLevel();
+    uint32_t exampleID = level->randomAudioExample();
     if (!exampleID)
     {
       LOG_DEBUG("Couldn't get random audio example\n");
@@ -32,18 +27,17 @@ namespace Bot
     }
     LOG_DEBUG("Example ID selected: {}\n", exampleID);
 
-    uint32_t audioID = search_->example->audio_for_example(exampleID);
-    const std::string performer = search_->example->author_for_audio_example(audioID);
-    const std::string license = search_->example->license_for_audio_example(audioID);
-    const std::string exampleText = search_->example->tatoeba_example(exampleID);
-    auto engTranslations = search_->example->tatoeba_translation_eng(exampleID);
+    uint32_t audioID = dictionary().example->audio_for_example(exampleID);
+    const AudioRelay::Audio audio = tatoebaAudio(audioID);
+    const std::string exampleText = dictionary().example->tatoeba_example(exampleID);
+    auto engTranslations = dictionary().example->tatoeba_translation_eng(exampleID);
     // select random translation    
     std::string engTranslation;
     if (!engTranslations.empty())
     {
       engTranslation = engTranslations[std::rand() % engTranslations.size()];
     }
-    auto rusTranslations = search_->example->tatoeba_translation_rus(exampleID);
+    auto rusTranslations = dictionary().example->tatoeba_translation_rus(exampleID);
     std::string rusTranslation;
     if (!rusTranslations.empty())
     {
@@ -51,54 +45,119 @@ namespace Bot
     }
 
     const std::string cacheID = getAudioCache(exampleID);
-    const std::string licenseText = std::format("This work by {} is licensed under {}.", performer.empty() ? "Anonymous" : performer, license.empty() ? "CC BY 4.0" : license);
-    bot_.getApi().sendMessage(userID, std::format("Japanese: ||{}||", escapeMarkdownV2(exampleText)), false, 0, std::make_shared<TgBot::GenericReply>(), "MarkdownV2");
+    auto spoiler = [](std::string_view label, std::string_view text)
+    { return MessageBuilder(Escape::markdownV2).raw(label).raw(": ||").text(text).raw("||").str(); };
+    sender_->sendMessage(userID, spoiler("Japanese", exampleText), nullptr, "MarkdownV2");
     if(!engTranslation.empty())
-      bot_.getApi().sendMessage(userID, std::format("English: ||{}||", escapeMarkdownV2(engTranslation)), false, 0, std::make_shared<TgBot::GenericReply>(), "MarkdownV2");
+      sender_->sendMessage(userID, spoiler("English", engTranslation), nullptr, "MarkdownV2");
     if (!rusTranslation.empty())
-      bot_.getApi().sendMessage(userID, std::format("Russian: ||{}||", escapeMarkdownV2(rusTranslation)), false, 0, std::make_shared<TgBot::GenericReply>(), "MarkdownV2");
+      sender_->sendMessage(userID, spoiler("Russian", rusTranslation), nullptr, "MarkdownV2");
 
     if (!cacheID.empty())
     {
       LOG_DEBUG("Found audio in cache: {}\n", cacheID);
-      auto message = bot_.getApi().sendAudio(userID, cacheID, licenseText, 0, performer, "Tatoeba");
-      if (message)
-      {
-        LOG_DEBUG("Sent audio message with ID {}\n", message->audio->fileId);
-      }
-      else
-      {
-        LOG_DEBUG("Failed to send audio message\n");
-      }
-      bot_.getApi().sendMessage(message->chat->id, "Continue?", false, 0, continueKeyboard_);
-      commandStack_[message->chat->id] = BotCommand::gameAudition;
+      sender_->post(userID, [this, userID, cacheID, audio]()
+                    {
+                      if (bot_.getApi().sendAudio(userID, cacheID, audio.caption, 0, audio.performer, audio.title))
+                      {
+                        LOG_DEBUG("Sent audio message with ID {}\n", cacheID);
+                      }
+                      else
+                      {
+                        LOG_DEBUG("Failed to send audio message\n");
+                      } });
+      sender_->sendMessage(userID, "Continue?", continueKeyboard_);
+      session(userID).command = BotCommand::gameAudition;
       return *this;
     }
 
-    std::string audioURL = search_->example->url_for_audio_example(audioID);
+    const std::string audioURL = dictionary().example->url_for_audio_example(audioID);
     LOG_DEBUG("Audio URL: {}\n", audioURL);
 
-    std::string audioFilename = downloadURL(audioURL, getTempFileName(), true);
-    if (audioFilename.empty())
-    {
-      LOG_DEBUG("Failed to download audio file\n");
-      return *this;
-    }
-    LOG_DEBUG("Audio file: {}\n", audioFilename);
-    const std::string audioMimeType = "audio/mpeg";
-    auto message = bot_.getApi().sendAudio(userID, TgBot::InputFile::fromFile(audioFilename, audioMimeType), licenseText, 0, performer, "Tatoeba");
-    if (message)
+    // Streamed from Tatoeba into the upload, the upload starts with the first
+    // bytes. The scheduler only paces the start, the transfers run on the
+    // HTTP client and the rest continues on the user's strand.
+    sender_->post(userID, [this, userID, exampleID, audioURL, audio]()
+                  { relay_->relay(userID, audioURL, audio, [this, userID, exampleID, audioURL, audio](AudioRelay::Result result)
+                                  { session(userID).post([this, userID, exampleID, audioURL, audio, result]()
+                                                         { audioRelayed(userID, exampleID, audioURL, audio, result); }); }); });
+    session(userID).command = BotCommand::gameAudition;
+    return *this;
+  }
+
+  void BotCommander::audioRelayed(int64_t userID, uint32_t exampleID, const std::string &audioURL, const AudioRelay::Audio &audio,
+                                  const AudioRelay::Result &result)
+  {
+    if (result.uploaded)
     {
-      storeAudioCache(message->audio->fileId, audioID);
-      LOG_DEBUG("Sent audio message with ID {}\n", message->audio->fileId);
+      // Without an ID the chat still has the clip, it just isn't cached
+      if (!result.fileID.empty())
+      {
+        storeAudioCache(result.fileID, exampleID);
+        LOG_DEBUG("Sent audio message with ID {}\n", result.fileID);
+      }
+      sender_->sendMessage(userID, "Continue?", continueKeyboard_);
+      return;
     }
-    else
+
+    LOG_DEBUG("Audio relay failed, uploading from memory\n");
+    http_->get(audioURL, [this, userID, exampleID, audio](HttpClient::Response response)
+               {
+                 if (!response.ok())
+                 {
+                   LOG_INFO("Download of audio example {} failed: {} (status {})\n", exampleID, curl_easy_strerror(response.result), response.status);
+                   sender_->sendMessage(userID, "Continue?", continueKeyboard_);
+                   return;
+                 }
+                 auto file = std::make_shared<TgBot::InputFile>();
+                 file->data = std::move(response.body);
+                 file->mimeType = "audio/mpeg";
+                 file->fileName = "audio.mp3";
+                 sender_->post(userID, [this, userID, exampleID, audio, file]()
+                               {
+                                 const TgBot::Message::Ptr message = bot_.getApi().sendAudio(userID, file, audio.caption, 0, audio.performer, audio.title);
+                                 if (!message || !message->audio)
+                                 {
+                                   LOG_DEBUG("Failed to send audio message\n");
+                                   return;
+                                 }
+                                 const std::string fileID = message->audio->fileId;
+                                 LOG_DEBUG("Sent audio message with ID {}\n", fileID);
+                                 session(userID).post([this, exampleID, fileID]()
+                                                      { storeAudioCache(fileID, exampleID); }); });
+                 sender_->sendMessage(userID, "Continue?", continueKeyboard_); });
+  }
+
+  AudioRelay::Audio BotCommander::tatoebaAudio(uint32_t audioID)
+  {
+    const std::string performer = dictionary().example->author_for_audio_example(audioID);
+    const std::string license = dictionary().example->license_for_audio_example(audioID);
+    AudioRelay::Audio audio;
+    audio.caption = std::format("This work by {} is licensed under {}.", performer.empty() ? "Anonymous" : performer, license.empty() ? "CC BY 4.0" : license);
+    audio.performer = performer;
+    audio.title = "Tatoeba";
+    return audio;
+  }
+
+  std::future<bool> BotCommander::prewarmAudio(int64_t chatID, uint32_t exampleID)
+  {
+    auto uploaded = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = uploaded->get_future();
+    const uint32_t audioID = dictionary().example->audio_for_example(exampleID);
+    const std::string audioURL = dictionary().example->url_for_audio_example(audioID);
+    if (audioURL.empty())
     {
-      LOG_DEBUG("Failed to send audio message\n");
+      uploaded->set_value(false);
+      return result;
     }
-    std::remove(audioFilename.c_str());
-    bot_.getApi().sendMessage(message->chat->id, "Continue?", false, 0, continueKeyboard_);
-    commandStack_[message->chat->id] = BotCommand::gameAudition;
-    return *this;
+    const AudioRelay::Audio audio = tatoebaAudio(audioID);
+    // Paced with everything else the bot sends, the ID is cached on the chat's strand
+    sender_->post(chatID, [this, chatID, exampleID, audioURL, audio, uploaded]()
+                  { relay_->relay(chatID, audioURL, audio, [this, chatID, exampleID, uploaded](AudioRelay::Result relayed)
+                                  { session(chatID).post([this, exampleID, uploaded, relayed]()
+                                                         {
+                                                           // Keyed by example, the way commandQuizListening looks clips up
+                                                           uploaded->set_value(!relayed.fileID.empty() && storeAudioCache(relayed.fileID, exampleID)); }); }); });
+    return result;
   }
 }
\ No newline at end of file
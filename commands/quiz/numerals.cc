@@ -1,18 +1,10 @@
 #include <random>
-#include <future>
 #include <thread>
 #include "utils.hpp"
 #include "botcommander.hpp"
 #include "metrics/profiler.hpp"
 #include "log.hpp"
 
-namespace
-{
-  uint64_t initialNumber = 0;
-  std::string correctNumeralString;
-  TgBot::Message::Ptr inputMessage;
-  TgBot::Message::Ptr outputMessage;
-}
 namespace Bot
 {
 
@@ -20,119 +12,134 @@ namespace Bot
   {
     LOG_DEBUG("User {} is training japanese numerals\n", userID);
 
-    Training::JlptTraining::Ptr training = std::make_unique<Training::JlptTraining>(5);
-    initialNumber = training->getRandomNumber();
-    correctNumeralString = training->getNumberString(initialNumber);
-    LOG_DEBUG("Initial number: {} = [{}]\n", initialNumber, correctNumeralString);
+    const QuestionBank::Level *level = quizLevel(userID, QuestionBank::QUIZ_LEVEL);
+    if (!level)
+    {
+      return *this;
+    }
+    NumeralsQuiz state;
+    state.number = level->randomNumber();
+    state.answer = level->numberString(state.number);
+    LOG_DEBUG("Initial number: {} = [{}]\n", state.number, state.answer);
+    NumeralsQuiz *quiz = quizzes_->start(userID, session(userID).quiz, std::move(state));
+    if (!quiz)
+    {
+      sender_->sendMessage(userID, "Too many quizzes are running right now, please try again in a minute.");
+      return *this;
+    }
 
-    inputMessage = bot_.getApi().sendMessage(userID, std::format("Spell {}", initialNumber), false, 0, numeralKeyboard_);
-    outputMessage = bot_.getApi().sendMessage(userID, "Reply:");
+    // The keyboard works once both message IDs are back. They are recorded on
+    // the user's strand, where a newer quiz has made the handle stale.
+    const QuizStore::Handle handle = session(userID).quiz;
+    auto sendRecorded = [this, userID, handle](std::string text, TgBot::GenericReply::Ptr replyMarkup, int32_t NumeralsQuiz::*field)
+    {
+      sender_->post(userID, [this, userID, handle, text = std::move(text), replyMarkup, field]()
+                    {
+                      const TgBot::Message::Ptr message = bot_.getApi().sendMessage(userID, text, false, 0, replyMarkup);
+                      const int32_t messageID = message ? message->messageId : 0;
+                      session(userID).post([this, handle, field, messageID]()
+                                           {
+                                             if (NumeralsQuiz *quiz = quizzes_->find<NumeralsQuiz>(handle))
+                                             {
+                                               quiz->*field = messageID;
+                                             } }); });
+    };
+    sendRecorded(std::format("Spell {}", quiz->number), numeralKeyboard_, &NumeralsQuiz::inputMessageID);
+    sendRecorded("Reply:", nullptr, &NumeralsQuiz::outputMessageID);
     return *this;
   }
 
   const BotCommander &BotCommander::commandQuizNumeralCounters(int64_t userID)
   {
-    Training::JlptTraining::Ptr training = std::make_unique<Training::JlptTraining>(5);
-    uint32_t id = training->getRandomCounterSuffix();
+    const QuestionBank::Level *level = quizLevel(userID, QuestionBank::QUIZ_LEVEL);
+    if (!level)
+    {
+      return *this;
+    }
+    if (level->counters() < 4)
+    {
+      LOG_DEBUG("Not enough counters for a quiz: {}\n", level->counters());
+      sender_->sendMessage(userID, "No meanings for counter, it's probably a bug.");
+      return *this;
+    }
+
+    // Bank indices, the counter IDs are only needed for the kanji lookup
+    uint32_t counter = level->randomCounter();
     std::vector<std::string> kanjies;
     unsigned maxCount = 20;
     while (maxCount--)
     {
-      kanjies = search_->jmdict->kanji_by_id(id);
+      kanjies = dictionary().jmdict->kanji_by_id(level->counterID(counter));
       if (!kanjies.empty())
         break;
-      id = training->getRandomCounterSuffix();
+      counter = level->randomCounter();
     }
 
     if (kanjies.empty())
     {
-      LOG_DEBUG("No kanji for counter {}\n", id);
-      bot_.getApi().sendMessage(userID, "No kanji for counter, it's probably a bug.");
+      LOG_DEBUG("No kanji for counter {}\n", level->counterID(counter));
+      sender_->sendMessage(userID, "No kanji for counter, it's probably a bug.");
       return *this;
     }
 
     std::string counterKanji = kanjies.front();
-    std::vector<std::string> counterMeanings = training->getCounterDescription(id);
-    if (counterMeanings.empty())
+    std::vector<uint32_t> counters = {counter};
+    while (counters.size() < 4)
     {
-      LOG_DEBUG("No meanings for counter {}\n", counterKanji);
-      bot_.getApi().sendMessage(userID, "No meanings for counter, it's probably a bug.");
-      return *this;
-    }
-    std::string correctTranslation = counterMeanings.front();
-
-    unsigned optionsCount = 0;
-    std::vector<uint32_t> ids;
-    while (optionsCount < 3)
-    {
-      uint32_t idOptional = training->getRandomCounterSuffix();
-      auto gloss = training->getCounterDescription(idOptional);
-      if (gloss.empty())
-        continue;
-
-      ids.push_back(idOptional);
-      optionsCount++;
+      const uint32_t other = level->randomCounter();
+      if (std::find(counters.begin(), counters.end(), other) == counters.end())
+      {
+        counters.push_back(other);
+      }
     }
-    ids.push_back(id);
-    std::shuffle(ids.begin(), ids.end(), std::mt19937(std::random_device()()));
-    uint32_t index = std::distance(ids.begin(), std::find(ids.begin(), ids.end(), id));
+    std::shuffle(counters.begin(), counters.end(), std::mt19937(std::random_device()()));
+    uint32_t index = std::distance(counters.begin(), std::find(counters.begin(), counters.end(), counter));
     std::vector<std::string> translations;
-    for (auto id : ids)
+    for (uint32_t option : counters)
     {
-      auto meanings = training->getCounterDescription(id);
-      if (meanings.empty())
-      {
-        LOG_DEBUG("No meanings for counter {}\n", id);
-        continue;
-      }
-      translations.push_back(meanings.front());
+      translations.emplace_back(level->counterMeaning(option));
     }
 
-    std::string correctCounter = training->getNumberString(1) + counterKanji;
-    bot_.getApi().sendPoll(userID, correctCounter, translations, false, 0, std::make_shared<TgBot::GenericReply>(), false, "quiz", false, index);
+    std::string correctCounter = level->numberString(1) + counterKanji;
+    sender_->post(userID, [this, userID, correctCounter, translations, index]()
+                  { bot_.getApi().sendPoll(userID, correctCounter, translations, false, 0, std::make_shared<TgBot::GenericReply>(), false, "quiz", false, index); });
     return *this;
   }
 
   const BotCommander &BotCommander::commandQuizNumeralsCallback(int64_t userID, const std::string &data)
   {
-    static std::string userReplyText;
+    UserSession &userSession = session(userID);
+    NumeralsQuiz *quiz = quizzes_->find<NumeralsQuiz>(userSession.quiz);
     LOG_DEBUG("User {} is inputting numerals: {}\n", userID, data);
+    if (!quiz || !quiz->inputMessageID || !quiz->outputMessageID)
+    {
+      LOG_DEBUG("User {} has no numerals quiz in progress\n", userID);
+      return *this;
+    }
 
     if (data == "=")
     {
-      userReplyText = "";
-      bot_.getApi().deleteMessage(userID, inputMessage->messageId);
-      if (userReplyText == correctNumeralString)
+      const int32_t inputMessageID = quiz->inputMessageID;
+      sender_->post(userID, [this, userID, inputMessageID]()
+                    { bot_.getApi().deleteMessage(userID, inputMessageID); });
+      if (quiz->reply == quiz->answer)
       {
-        bot_.getApi().sendMessage(userID, "Correct!");
+        sender_->sendMessage(userID, "Correct!");
       }
       else
       {
-        bot_.getApi().sendMessage(userID, std::format("Wrong! Correct answer is {} = {}", initialNumber, correctNumeralString));
+        sender_->sendMessage(userID, std::format("Wrong! Correct answer is {} = {}", quiz->number, quiz->answer));
       }
-      inputMessage.reset();
-      outputMessage.reset();
-      bot_.getApi().sendMessage(userID, "Continue?", false, 0, continueKeyboard_);
+      quizzes_->finish(userSession.quiz);
+      sender_->sendMessage(userID, "Continue?", continueKeyboard_);
       return *this;
     }
-    else
+    else if (quiz->reply.size() + data.size() <= NumeralsQuiz::MAX_REPLY)
     {
-      userReplyText += data;
-      while (true)
-      {
-        std::string userInputformatted = std::format("Reply:{}", userReplyText);
-        auto result = bot_.getApi().editMessageText(userInputformatted, userID, outputMessage->messageId);
-        if (result != nullptr)
-        {
-          LOG_DEBUG("Edited message\n");
-          break;
-        }
-        else
-        {
-          LOG_DEBUG("Failed to edit message\n");
-          std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-      }
+      quiz->reply += data;
+      const int32_t outputMessageID = quiz->outputMessageID;
+      sender_->post(userID, [this, userID, outputMessageID, text = std::format("Reply:{}", quiz->reply)]()
+                    { bot_.getApi().editMessageText(text, userID, outputMessageID); });
     }
     return *this;
   }
@@ -145,18 +152,14 @@ namespace Bot
     std::uniform_int_distribution<> dis(0, 1);
     int choice = dis(gen);
     LOG_DEBUG("Random choice: {}\n", choice);
-    commandStack_[userID] = BotCommand::gameNumerals;
+    session(userID).command = BotCommand::gameNumerals;
     if (choice == 0)
     {
-      std::thread([this, userID]()
-                  { this->commandQuizJapaneseNumerals(userID); })
-          .detach();
+      commandQuizJapaneseNumerals(userID);
     }
     else if (choice == 1)
     {
-      std::thread([this, userID]()
-                  { this->commandQuizNumeralCounters(userID); })
-          .detach();
+      commandQuizNumeralCounters(userID);
     }
     return *this;
   }
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <array>
+#include <random>
+#include "botcommander.hpp"
+#include "inflection.hpp"
+#include "log.hpp"
+
+namespace
+{
+  using Bot::Inflection::Form;
+
+  // Verbs are a fraction of a level, this many draws nearly always find one
+  constexpr size_t MAX_VERB_DRAWS = 64;
+  constexpr size_t QUIZ_OPTIONS = 4;
+
+  constexpr std::array<Form, 16> QUIZ_FORMS = {
+      Form::negative, Form::past, Form::negativePast, Form::te, Form::polite, Form::politePast, Form::politeNegative,
+      Form::politeNegativePast, Form::politeVolitional, Form::volitional, Form::potential, Form::passive,
+      Form::causative, Form::imperative, Form::conditional, Form::desire,
+  };
+
+  // Classes a learner confuses a verb with: る verbs get both treatments,
+  // the irregular ones the regular endings
+  constexpr std::array<Bot::Inflection::Class, 4> WRONG_CLASSES = {
+      Bot::Inflection::godan, Bot::Inflection::ichidan, Bot::Inflection::suru, Bot::Inflection::kuru,
+  };
+}
+
+namespace Bot
+{
+  const BotCommander &BotCommander::commandQuizVerbs(int64_t userID)
+  {
+    LOG_DEBUG("User {} wants to train verb conjugation\n", userID);
+    const QuestionBank::Level *level = quizLevel(userID, QuestionBank::QUIZ_LEVEL);
+    if (!level)
+    {
+      sender_->sendMessage(userID, "BUG: Failed to create training");
+      return *this;
+    }
+    uint32_t word = QuestionBank::NONE;
+    Inflection::Class verbClass = Inflection::none;
+    for (size_t draw = 0; draw < MAX_VERB_DRAWS && !verbClass; ++draw)
+    {
+      word = level->randomWord();
+      if (word == QuestionBank::NONE || level->readings(word).empty() || level->glosses(word).empty())
+      {
+        continue;
+      }
+      verbClass = Inflection::verbClass(level->word(word), level->readings(word).front(), level->glosses(word).front());
+    }
+    if (!verbClass)
+    {
+      LOG_DEBUG("Couldn't get random verb\n");
+      sender_->sendMessage(userID, "BUG: Couldn't get random verb");
+      return *this;
+    }
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    const Form form = QUIZ_FORMS[std::uniform_int_distribution<size_t>(0, QUIZ_FORMS.size() - 1)(gen)];
+    const std::string_view writing = level->word(word);
+    // The same form as if the verb were of another class comes first, other
+    // forms of the verb fill the rest
+    std::vector<std::string> options{Inflection::conjugate(writing, verbClass, form)};
+    auto offer = [&options](std::string option)
+    {
+      if (options.size() < QUIZ_OPTIONS && !option.empty() && std::find(options.begin(), options.end(), option) == options.end())
+      {
+        options.push_back(std::move(option));
+      }
+    };
+    for (const Inflection::Class wrongClass : WRONG_CLASSES)
+    {
+      if (wrongClass != verbClass)
+      {
+        offer(Inflection::conjugate(writing, wrongClass, form));
+      }
+    }
+    std::array<Form, QUIZ_FORMS.size()> others = QUIZ_FORMS;
+    std::shuffle(others.begin(), others.end(), gen);
+    for (const Form other : others)
+    {
+      offer(Inflection::conjugate(writing, verbClass, other));
+    }
+    const std::string correct = options.front();
+    std::shuffle(options.begin(), options.end(), gen);
+    const int32_t index = static_cast<int32_t>(std::find(options.begin(), options.end(), correct) - options.begin());
+
+    const std::string question = std::format("{} ({}): {}", writing, level->readings(word).front(), Inflection::formName(form));
+    LOG_DEBUG("Verb: {}, form: {}, Matching index: {} [{}]\n", writing, Inflection::formName(form), index, correct);
+    sender_->sendMessage(userID, "_Pick the right form_", nullptr, "Markdown");
+    sender_->post(userID, [this, userID, question, options, index]()
+                  { bot_.getApi().sendPoll(userID, question, options, false, 0, std::make_shared<TgBot::GenericReply>(), false, "quiz", false, index); });
+    session(userID).command = BotCommand::gameVerbs;
+    LOG_DEBUG("Finished quiz verbs\n");
+    return *this;
+  }
+}
\ No newline at end of file
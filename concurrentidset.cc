@@ -0,0 +1,111 @@
+#include "concurrentidset.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace Bot
+{
+  ConcurrentIdSet::Table::Table(size_t capacity)
+      : mask(capacity - 1), slots(std::make_unique<std::atomic<int64_t>[]>(capacity))
+  {
+    for (size_t i = 0; i < capacity; ++i)
+    {
+      slots[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  ConcurrentIdSet::ConcurrentIdSet(size_t capacity)
+  {
+    tables_.push_back(std::make_unique<Table>(std::bit_ceil(std::max<size_t>(capacity, 16))));
+    table_.store(tables_.back().get(), std::memory_order_release);
+  }
+
+  size_t ConcurrentIdSet::slotFor(int64_t id, size_t mask)
+  {
+    // splitmix64 finalizer, Telegram IDs are far from uniform in the low bits
+    uint64_t x = static_cast<uint64_t>(id);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return (x ^ (x >> 31)) & mask;
+  }
+
+  void ConcurrentIdSet::place(Table &table, int64_t id)
+  {
+    for (size_t slot = slotFor(id, table.mask);; slot = (slot + 1) & table.mask)
+    {
+      if (!table.slots[slot].load(std::memory_order_relaxed))
+      {
+        table.slots[slot].store(id, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  bool ConcurrentIdSet::contains(int64_t id) const
+  {
+    if (!id)
+    {
+      return false;
+    }
+
+    const Table &table = *table_.load(std::memory_order_acquire);
+    for (size_t slot = slotFor(id, table.mask);; slot = (slot + 1) & table.mask)
+    {
+      const int64_t current = table.slots[slot].load(std::memory_order_acquire);
+      if (current == id)
+      {
+        return true;
+      }
+      if (!current)
+      {
+        return false;
+      }
+    }
+  }
+
+  bool ConcurrentIdSet::insert(int64_t id)
+  {
+    if (!id)
+    {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    if (contains(id))
+    {
+      return false;
+    }
+
+    Table *table = table_.load(std::memory_order_relaxed);
+    const size_t capacity = table->mask + 1;
+    if ((size_ + 1) * 2 > capacity)
+    {
+      auto grown = std::make_unique<Table>(capacity * 2);
+      for (size_t i = 0; i < capacity; ++i)
+      {
+        if (const int64_t current = table->slots[i].load(std::memory_order_relaxed))
+        {
+          place(*grown, current);
+        }
+      }
+      table = grown.get();
+      tables_.push_back(std::move(grown));
+    }
+
+    place(*table, id);
+    table_.store(table, std::memory_order_release);
+    size_++;
+    return true;
+  }
+
+  size_t ConcurrentIdSet::memoryUsage() const
+  {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    size_t total = 0;
+    for (const auto &table : tables_)
+    {
+      total += (table->mask + 1) * sizeof(std::atomic<int64_t>);
+    }
+    return total;
+  }
+}
\ No newline at end of file
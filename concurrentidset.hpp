@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Bot
+{
+  // Grow-only set of non-zero 64-bit IDs. contains() is lock-free: it probes
+  // an open-addressing table of atomics. Writers are serialized and replace
+  // the table with a larger copy when it gets half full; replaced tables are
+  // kept until the set is destroyed because readers may still be probing them.
+  class ConcurrentIdSet
+  {
+  public:
+    ConcurrentIdSet(size_t capacity = 1024);
+    ConcurrentIdSet(const ConcurrentIdSet &) = delete;
+    ConcurrentIdSet &operator=(const ConcurrentIdSet &) = delete;
+
+    bool contains(int64_t id) const;
+    // Returns false if the ID was already present
+    bool insert(int64_t id);
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+    size_t memoryUsage() const;
+
+  private:
+    struct Table
+    {
+      Table(size_t capacity);
+
+      const size_t mask;
+      std::unique_ptr<std::atomic<int64_t>[]> slots;
+    };
+
+    static size_t slotFor(int64_t id, size_t mask);
+    static void place(Table &table, int64_t id);
+
+    std::atomic<Table *> table_;
+    std::atomic<size_t> size_ = 0;
+    mutable std::mutex writeMutex_;
+    std::vector<std::unique_ptr<Table>> tables_;
+  };
+}
\ No newline at end of file
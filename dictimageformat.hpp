@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// On-disk layout of the compiled dictionary image, shared by the offline
+// compiler (tools/dictcompiler.cc) and DictionaryImage. All integers are
+// native little-endian, every section starts 8-byte aligned.
+namespace Bot::DictImage
+{
+  constexpr char MAGIC[8] = {'W', 'A', 'K', 'A', 'D', 'I', 'C', 'T'};
+  // Bump on any layout change, older images are then ignored
+  constexpr uint32_t VERSION = 1;
+  constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  enum Section : uint32_t
+  {
+    strings,        // UTF-8 blob, every StringRef points into it
+    entryIDs,       // uint32_t dictionary IDs, ascending
+    fieldBegin,     // uint32_t index into values of each (entry, field), plus an end marker
+    values,         // StringRef, field values in dictionary order
+    writingIndex,   // IndexEntry sorted by key
+    readingIndex,   // IndexEntry sorted by key
+    glossIndex,     // IndexEntry sorted by key, keys normalized
+    glossWordIndex, // IndexEntry sorted by key, one per word of a gloss, normalized
+    sectionCount,
+  };
+
+  // Per-entry fields, in fieldBegin order
+  enum Field : uint32_t
+  {
+    writing,
+    reading,
+    gloss,
+    fieldCount,
+  };
+
+  struct StringRef
+  {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  struct IndexEntry
+  {
+    StringRef key;
+    uint32_t entry; // position in entryIDs
+  };
+
+  struct SectionRef
+  {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t fileSize;
+    uint32_t entries;
+    uint32_t reserved;
+    SectionRef sections[sectionCount];
+  };
+
+  // Lowercases ASCII and collapses runs of whitespace. Gloss keys are stored
+  // this way and queries must be normalized the same before lookup.
+  inline std::string normalize(std::string_view text)
+  {
+    std::string result;
+    result.reserve(text.size());
+    bool space = false;
+    for (const char c : text)
+    {
+      if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+      {
+        space = !result.empty();
+        continue;
+      }
+      if (space)
+      {
+        result += ' ';
+        space = false;
+      }
+      result += c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    return result;
+  }
+}
\ No newline at end of file
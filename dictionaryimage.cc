@@ -0,0 +1,152 @@
+#include "dictionaryimage.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Bot
+{
+  DictionaryImage::Ptr DictionaryImage::open(const std::string &path)
+  {
+    const auto started = std::chrono::steady_clock::now();
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+      LOG_INFO("No dictionary image at {}, using the dictionary library\n", path);
+      return nullptr;
+    }
+
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(DictImage::Header))
+    {
+      data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    // The mapping keeps the file referenced
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+      LOG_INFO("Failed to map dictionary image {}\n", path);
+      return nullptr;
+    }
+    // Lookups jump around the index, read-ahead would only waste page cache
+    madvise(data, info.st_size, MADV_RANDOM);
+
+    Ptr image(new DictionaryImage(data, info.st_size));
+    if (!image->validate())
+    {
+      LOG_INFO("Ignoring dictionary image {}: wrong version or corrupted\n", path);
+      return nullptr;
+    }
+
+    const auto header = reinterpret_cast<const DictImage::Header *>(image->data_);
+    image->strings_ = image->data_ + header->sections[DictImage::strings].offset;
+    image->stringsSize_ = header->sections[DictImage::strings].size;
+    image->entryIDs_ = image->section<uint32_t>(DictImage::entryIDs);
+    image->fieldBegin_ = image->section<uint32_t>(DictImage::fieldBegin);
+    image->values_ = image->section<DictImage::StringRef>(DictImage::values);
+
+    const auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+    LOG_INFO("Dictionary image {} mapped in {}us: {} entries, {} bytes\n", path, elapsedUs, image->size(), image->size_);
+    return image;
+  }
+
+  DictionaryImage::DictionaryImage(const void *data, size_t size)
+      : data_(static_cast<const char *>(data)), size_(size)
+  {
+  }
+
+  DictionaryImage::~DictionaryImage()
+  {
+    munmap(const_cast<char *>(data_), size_);
+  }
+
+  // Only the header and the section bounds are checked, the contents are
+  // trusted: checking every reference would mean touching the whole file.
+  bool DictionaryImage::validate() const
+  {
+    const auto header = reinterpret_cast<const DictImage::Header *>(data_);
+    if (std::memcmp(header->magic, DictImage::MAGIC, sizeof(DictImage::MAGIC)) != 0 ||
+        header->version != DictImage::VERSION ||
+        header->byteOrder != DictImage::BYTE_ORDER_MARK ||
+        header->fileSize != size_)
+    {
+      return false;
+    }
+    for (const DictImage::SectionRef &section : header->sections)
+    {
+      if (section.offset % 8 || section.offset > size_ || section.size > size_ - section.offset)
+      {
+        return false;
+      }
+    }
+    const uint64_t entries = header->entries;
+    return header->sections[DictImage::entryIDs].size == entries * sizeof(uint32_t) &&
+           header->sections[DictImage::fieldBegin].size == (entries * DictImage::fieldCount + 1) * sizeof(uint32_t);
+  }
+
+  template <typename T>
+  std::span<const T> DictionaryImage::section(DictImage::Section id) const
+  {
+    const auto header = reinterpret_cast<const DictImage::Header *>(data_);
+    const DictImage::SectionRef &ref = header->sections[id];
+    return std::span<const T>(reinterpret_cast<const T *>(data_ + ref.offset), ref.size / sizeof(T));
+  }
+
+  uint32_t DictionaryImage::find(uint32_t id) const
+  {
+    auto it = std::lower_bound(entryIDs_.begin(), entryIDs_.end(), id);
+    return it != entryIDs_.end() && *it == id ? static_cast<uint32_t>(it - entryIDs_.begin()) : NONE;
+  }
+
+  std::span<const DictImage::StringRef> DictionaryImage::values(uint32_t entry, Field field) const
+  {
+    const size_t slot = static_cast<size_t>(entry) * DictImage::fieldCount + field;
+    return values_.subspan(fieldBegin_[slot], fieldBegin_[slot + 1] - fieldBegin_[slot]);
+  }
+
+  void DictionaryImage::search(Index index, std::string_view key, bool prefix, std::vector<uint32_t> &ids, size_t limit) const
+  {
+    const auto entries = section<DictImage::IndexEntry>(static_cast<DictImage::Section>(index));
+    auto it = std::lower_bound(entries.begin(), entries.end(), key, [this](const DictImage::IndexEntry &entry, std::string_view key)
+                               { return string(entry.key) < key; });
+    for (size_t found = 0; it != entries.end() && found < limit; ++it, ++found)
+    {
+      const std::string_view value = string(it->key);
+      if (prefix ? !value.starts_with(key) : value != key)
+      {
+        break;
+      }
+      ids.push_back(entryIDs_[it->entry]);
+    }
+  }
+
+  void DictionaryImage::search(Index index, std::span<const std::string_view> keys, std::vector<std::pair<uint32_t, uint32_t>> &hits,
+                               size_t limit) const
+  {
+    const auto entries = section<DictImage::IndexEntry>(static_cast<DictImage::Section>(index));
+    std::vector<uint32_t> order(keys.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+    {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [keys](uint32_t a, uint32_t b)
+              { return keys[a] < keys[b]; });
+    auto from = entries.begin();
+    for (const uint32_t key : order)
+    {
+      from = std::lower_bound(from, entries.end(), keys[key], [this](const DictImage::IndexEntry &entry, std::string_view key)
+                              { return string(entry.key) < key; });
+      auto it = from;
+      for (size_t found = 0; it != entries.end() && found < limit && string(it->key) == keys[key]; ++it, ++found)
+      {
+        hits.emplace_back(key, entryIDs_[it->entry]);
+      }
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "dictimageformat.hpp"
+
+namespace Bot
+{
+  // Read-only view of a compiled dictionary image (see tools/dictcompiler.cc).
+  // The file is mapped, not read: opening costs a header check, pages are
+  // loaded on first touch and shared with every process mapping the image.
+  class DictionaryImage
+  {
+  public:
+    using Ptr = std::unique_ptr<DictionaryImage>;
+    using Field = DictImage::Field;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    enum class Index
+    {
+      writing = DictImage::writingIndex,
+      reading = DictImage::readingIndex,
+      gloss = DictImage::glossIndex,
+      glossWord = DictImage::glossWordIndex,
+    };
+
+    // Returns nullptr if the file is missing, truncated or of another version
+    static Ptr open(const std::string &path);
+    ~DictionaryImage();
+    DictionaryImage(const DictionaryImage &) = delete;
+    DictionaryImage &operator=(const DictionaryImage &) = delete;
+
+    size_t size() const { return entryIDs_.size(); }
+    size_t mappedSize() const { return size_; }
+    // Position of the entry with the given dictionary ID or NONE
+    uint32_t find(uint32_t id) const;
+    uint32_t id(uint32_t entry) const { return entryIDs_[entry]; }
+    std::span<const DictImage::StringRef> values(uint32_t entry, Field field) const;
+    std::string_view string(const DictImage::StringRef &ref) const { return std::string_view(strings_ + ref.offset, ref.length); }
+
+    // Appends the dictionary IDs of up to limit entries whose key equals (or,
+    // with prefix set, starts with) key. Gloss keys must be normalized.
+    void search(Index index, std::string_view key, bool prefix, std::vector<uint32_t> &ids, size_t limit) const;
+    // Exact search for many keys in one pass over the index: keys are taken
+    // in sorted order and each binary search starts where the previous one
+    // ended. Appends (position in keys, dictionary ID), up to limit per key.
+    void search(Index index, std::span<const std::string_view> keys, std::vector<std::pair<uint32_t, uint32_t>> &hits,
+                size_t limit) const;
+
+  private:
+    DictionaryImage(const void *data, size_t size);
+    bool validate() const;
+
+    template <typename T>
+    std::span<const T> section(DictImage::Section id) const;
+
+    const char *data_;
+    const size_t size_;
+    const char *strings_ = nullptr;
+    size_t stringsSize_ = 0;
+    std::span<const uint32_t> entryIDs_;
+    std::span<const uint32_t> fieldBegin_;
+    std::span<const DictImage::StringRef> values_;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "entrybatch.hpp"
+
+namespace Bot
+{
+  EntryBatch::EntryBatch(const DictionaryImage &image, std::span<const uint32_t> ids)
+      : ids_(ids.begin(), ids.end())
+  {
+    begin_.reserve(ids_.size() * fields + 1);
+    for (uint32_t id : ids_)
+    {
+      const uint32_t entry = image.find(id);
+      for (size_t field = 0; field < fields; ++field)
+      {
+        begin_.push_back(static_cast<uint32_t>(values_.size()));
+        if (entry == DictionaryImage::NONE)
+        {
+          continue;
+        }
+        for (const DictImage::StringRef &value : image.values(entry, static_cast<DictionaryImage::Field>(field)))
+        {
+          values_.push_back(image.string(value));
+        }
+      }
+    }
+    begin_.push_back(static_cast<uint32_t>(values_.size()));
+  }
+
+  std::span<const std::string_view> EntryBatch::get(size_t entry, Field field) const
+  {
+    const size_t slot = entry * fields + field;
+    return std::span<const std::string_view>(values_).subspan(begin_[slot], begin_[slot + 1] - begin_[slot]);
+  }
+
+  std::string_view EntryBatch::front(size_t entry, Field field) const
+  {
+    const auto values = get(entry, field);
+    return values.empty() ? std::string_view() : values.front();
+  }
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "dictionaryimage.hpp"
+
+namespace Bot
+{
+  // Writings, readings and glosses of a batch of dictionary image entries,
+  // looked up in one pass and stored struct-of-arrays style: every value is
+  // a view straight into the mapped image, so reading a field allocates
+  // nothing. The library has no such view, its values are copies per call.
+  class EntryBatch
+  {
+  public:
+    enum Field
+    {
+      writing = DictImage::writing,
+      reading = DictImage::reading,
+      gloss = DictImage::gloss,
+      fields = DictImage::fieldCount,
+    };
+
+    // IDs missing from the image come out as entries without values
+    EntryBatch(const DictionaryImage &image, std::span<const uint32_t> ids);
+    EntryBatch(const EntryBatch &) = delete;
+    EntryBatch &operator=(const EntryBatch &) = delete;
+
+    size_t size() const { return ids_.size(); }
+    uint32_t id(size_t entry) const { return ids_[entry]; }
+    std::span<const std::string_view> get(size_t entry, Field field) const;
+    // First value of the field or an empty view
+    std::string_view front(size_t entry, Field field) const;
+
+  private:
+    const std::vector<uint32_t> ids_;
+    std::vector<std::string_view> values_;
+    // Index into values_ of the first value of each (entry, field), plus an end marker
+    std::vector<uint32_t> begin_;
+  };
+}
\ No newline at end of file
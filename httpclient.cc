@@ -0,0 +1,299 @@
+#include "httpclient.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  constexpr long CONNECT_TIMEOUT_S = 10;
+  constexpr long TRANSFER_TIMEOUT_S = 60;
+  constexpr long MAX_CACHED_CONNECTIONS = 32;
+  // curl wakes the loop itself for its own timeouts, this only bounds the backoff check
+  constexpr std::chrono::milliseconds IDLE_POLL(1000);
+
+  bool transient(CURLcode result, long status)
+  {
+    switch (result)
+    {
+    case CURLE_OK:
+      return status == 429 || status >= 500;
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_GOT_NOTHING:
+    case CURLE_PARTIAL_FILE:
+    case CURLE_SSL_CONNECT_ERROR:
+    case CURLE_HTTP2:
+    case CURLE_HTTP2_STREAM:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  size_t appendBody(char *data, size_t size, size_t count, void *body)
+  {
+    static_cast<std::string *>(body)->append(data, size * count);
+    return size * count;
+  }
+}
+
+namespace Bot
+{
+  HttpClient::HttpClient(const HttpConfig &config)
+      : config_(config), generator_(std::random_device{}())
+  {
+    share_ = curl_share_init();
+    // Only the loop thread touches the share, it needs no lock callbacks
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    multi_ = curl_multi_init();
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(std::max<size_t>(1, config_.hostConnections)));
+    curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, MAX_CACHED_CONNECTIONS);
+
+    thread_ = std::thread(&HttpClient::run, this);
+    LOG_INFO("HTTP client started: {} connections per host, {} attempts\n", config_.hostConnections, config_.maxAttempts);
+  }
+
+  HttpClient::~HttpClient()
+  {
+    stop();
+    curl_multi_cleanup(multi_);
+    curl_share_cleanup(share_);
+  }
+
+  void HttpClient::stop()
+  {
+    stopping_ = true;
+    curl_multi_wakeup(multi_);
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+
+  void HttpClient::get(const std::string &url, Fetched fetched)
+  {
+    Transfer transfer;
+    transfer.response = std::make_shared<Response>();
+    transfer.fetched = std::move(fetched);
+
+    CURL *easy = curl_easy_init();
+    curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(easy, CURLOPT_USERAGENT, "Mozilla/5.0...");
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, CONNECT_TIMEOUT_S);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT, TRANSFER_TIMEOUT_S);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &appendBody);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer.response->body);
+    post([this, easy, transfer]()
+         { add(easy, transfer); });
+  }
+
+  void HttpClient::start(CURL *easy, Done done)
+  {
+    Transfer transfer;
+    transfer.done = std::move(done);
+    post([this, easy, transfer]()
+         { add(easy, transfer); });
+  }
+
+  void HttpClient::post(Task task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    curl_multi_wakeup(multi_);
+  }
+
+  void HttpClient::add(CURL *easy, Transfer transfer)
+  {
+    active_++;
+    transfers_.emplace(easy, std::move(transfer));
+    if (stopping_)
+    {
+      finish(easy, CURLE_ABORTED_BY_CALLBACK);
+      return;
+    }
+
+    curl_easy_setopt(easy, CURLOPT_SHARE, share_);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    // Wait for a connection that can multiplex rather than open another one
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_DNS_CACHE_TIMEOUT, static_cast<long>(config_.dnsCacheSeconds));
+    curl_multi_add_handle(multi_, easy);
+  }
+
+  void HttpClient::finish(CURL *easy, CURLcode result)
+  {
+    auto node = transfers_.extract(easy);
+    Transfer &transfer = node.mapped();
+    long status = 0;
+    long connects = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+    curl_multi_remove_handle(multi_, easy);
+    active_--;
+    transfersDone_++;
+    connections_ += connects;
+
+    if (!transfer.response)
+    {
+      failed_ += result != CURLE_OK;
+      try
+      {
+        transfer.done(result, status);
+      }
+      catch (const std::exception &e)
+      {
+        LOG_EXCEPTION("HTTP callback exception", e);
+      }
+      return;
+    }
+
+    transfer.response->result = result;
+    transfer.response->status = status;
+    if (!transfer.response->ok())
+    {
+      if (transient(result, status) && ++transfer.attempts < config_.maxAttempts && !stopping_)
+      {
+        retry(easy, std::move(transfer));
+        return;
+      }
+      failed_++;
+      LOG_INFO("HTTP request failed: {} (status {})\n", curl_easy_strerror(result), status);
+    }
+    curl_easy_cleanup(easy);
+    try
+    {
+      transfer.fetched(std::move(*transfer.response));
+    }
+    catch (const std::exception &e)
+    {
+      LOG_EXCEPTION("HTTP callback exception", e);
+    }
+  }
+
+  void HttpClient::retry(CURL *easy, Transfer transfer)
+  {
+    const auto delay = backoff(transfer.attempts);
+    LOG_INFO("HTTP request failed: {} (status {}), retry {} in {}ms\n",
+             curl_easy_strerror(transfer.response->result), transfer.response->status, transfer.attempts, delay.count());
+    retries_++;
+    transfer.response->body.clear();
+    backoff_.emplace(Clock::now() + delay, easy);
+    waiting_.emplace(easy, std::move(transfer));
+  }
+
+  std::chrono::milliseconds HttpClient::backoff(size_t attempts)
+  {
+    const size_t shift = std::min<size_t>(attempts - 1, 16);
+    const size_t delay = std::min(config_.maxBackoffMs, config_.backoffMs << shift);
+    // Jitter keeps requests that failed together from retrying together
+    return std::chrono::milliseconds(std::uniform_int_distribution<size_t>(delay / 2, delay)(generator_));
+  }
+
+  void HttpClient::run()
+  {
+    std::vector<Task> tasks;
+    while (true)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks.swap(tasks_);
+      }
+      for (auto &task : tasks)
+      {
+        task();
+      }
+      tasks.clear();
+      if (stopping_)
+      {
+        break;
+      }
+
+      const auto now = Clock::now();
+      while (!backoff_.empty() && backoff_.begin()->first <= now)
+      {
+        CURL *easy = backoff_.begin()->second;
+        backoff_.erase(backoff_.begin());
+        auto node = waiting_.extract(easy);
+        add(easy, std::move(node.mapped()));
+      }
+
+      int running = 0;
+      curl_multi_perform(multi_, &running);
+      int queued = 0;
+      while (CURLMsg *message = curl_multi_info_read(multi_, &queued))
+      {
+        if (message->msg == CURLMSG_DONE)
+        {
+          finish(message->easy_handle, message->data.result);
+        }
+      }
+
+      auto timeout = IDLE_POLL;
+      if (!backoff_.empty())
+      {
+        timeout = std::min(timeout, std::chrono::ceil<std::chrono::milliseconds>(backoff_.begin()->first - Clock::now()));
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!tasks_.empty())
+        {
+          continue;
+        }
+      }
+      if (timeout.count() > 0)
+      {
+        curl_multi_poll(multi_, nullptr, 0, static_cast<int>(timeout.count()), nullptr);
+      }
+    }
+
+    // Whatever is still queued or in flight fails, nobody is left to wait for it
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks.swap(tasks_);
+    }
+    for (auto &task : tasks)
+    {
+      task();
+    }
+    while (!transfers_.empty())
+    {
+      finish(transfers_.begin()->first, CURLE_ABORTED_BY_CALLBACK);
+    }
+    for (auto &[easy, transfer] : waiting_)
+    {
+      curl_easy_cleanup(easy);
+      try
+      {
+        transfer.fetched(std::move(*transfer.response));
+      }
+      catch (const std::exception &e)
+      {
+        LOG_EXCEPTION("HTTP callback exception", e);
+      }
+    }
+    waiting_.clear();
+    backoff_.clear();
+  }
+
+  HttpClient::Stats HttpClient::stats() const
+  {
+    Stats result;
+    result.active = active_;
+    result.transfers = transfersDone_;
+    result.connections = connections_;
+    result.retries = retries_;
+    result.failed = failed_;
+    return result;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <curl/curl.h>
+#include "botconfig.hpp"
+
+namespace Bot
+{
+  // Process-wide HTTP client. Every transfer runs on one event-loop thread
+  // over a single curl multi handle, so connections, TLS sessions and DNS
+  // lookups are reused across requests and HTTP/2 requests to one host share
+  // a connection. curl_global_init() must have been called before it is
+  // constructed.
+  class HttpClient
+  {
+  public:
+    using Ptr = std::unique_ptr<HttpClient>;
+    using Task = std::function<void()>;
+    // Called on the loop thread once the transfer has been removed from the multi handle
+    using Done = std::function<void(CURLcode result, long status)>;
+
+    struct Response
+    {
+      CURLcode result = CURLE_FAILED_INIT;
+      long status = 0;
+      std::string body;
+
+      bool ok() const { return result == CURLE_OK && status / 100 == 2; }
+    };
+
+    struct Stats
+    {
+      size_t active = 0;
+      uint64_t transfers = 0;
+      uint64_t connections = 0; // new connections, the rest of the transfers reused one
+      uint64_t retries = 0;
+      uint64_t failed = 0;
+    };
+
+    explicit HttpClient(const HttpConfig &config = HttpConfig());
+    ~HttpClient();
+    HttpClient(const HttpClient &) = delete;
+    HttpClient &operator=(const HttpClient &) = delete;
+
+    // Fetches the URL into memory. Connection errors, 429 and 5xx answers are
+    // retried with exponential backoff. fetched is called on the loop thread.
+    using Fetched = std::function<void(Response response)>;
+    void get(const std::string &url, Fetched fetched);
+
+    // Runs a transfer the caller set up. The handle and everything its
+    // callbacks use must stay alive until done is called. Not retried, a
+    // streamed body can't be replayed.
+    void start(CURL *easy, Done done);
+
+    // Runs the task on the loop thread, where paused transfers may be resumed.
+    void post(Task task);
+
+    // Ends the loop. Transfers still running or waiting for a retry fail with
+    // CURLE_ABORTED_BY_CALLBACK before it returns, anything posted later
+    // never runs.
+    void stop();
+
+    Stats stats() const;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Transfer
+    {
+      Done done;
+      // Set for get() requests only
+      std::shared_ptr<Response> response;
+      Fetched fetched;
+      size_t attempts = 0;
+    };
+
+    void run();
+    void add(CURL *easy, Transfer transfer);
+    void finish(CURL *easy, CURLcode result);
+    void retry(CURL *easy, Transfer transfer);
+    std::chrono::milliseconds backoff(size_t attempts);
+
+    const HttpConfig config_;
+    CURLM *multi_ = nullptr;
+    CURLSH *share_ = nullptr;
+
+    std::mutex mutex_;
+    std::vector<Task> tasks_;
+    std::atomic<bool> stopping_ = false;
+
+    // Loop thread only
+    std::unordered_map<CURL *, Transfer> transfers_;
+    std::multimap<Clock::time_point, CURL *> backoff_;
+    std::unordered_map<CURL *, Transfer> waiting_;
+    std::mt19937 generator_;
+
+    std::atomic<size_t> active_ = 0;
+    std::atomic<uint64_t> transfersDone_ = 0;
+    std::atomic<uint64_t> connections_ = 0;
+    std::atomic<uint64_t> retries_ = 0;
+    std::atomic<uint64_t> failed_ = 0;
+
+    std::thread thread_;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,355 @@
+#include "inflection.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  using Bot::Inflection::Class;
+  using Bot::Inflection::Form;
+  using namespace Bot::Inflection;
+
+  // A suffix in a fixed buffer so the rule table is built at compile time
+  struct Suffix
+  {
+    std::array<char, 31> text{};
+    uint8_t size = 0;
+
+    constexpr Suffix() = default;
+    constexpr Suffix(std::string_view head, std::string_view tail = {})
+    {
+      for (const std::string_view part : {head, tail})
+      {
+        for (const char c : part)
+        {
+          text[size++] = c;
+        }
+      }
+    }
+
+    constexpr std::string_view view() const { return std::string_view(text.data(), size); }
+  };
+
+  struct Rule
+  {
+    Suffix inflected;
+    Suffix base;
+    uint16_t inflectedClass;
+    Class baseClass;
+    Form form;
+  };
+
+  // The kana a godan verb ending takes in each row, plus its te and ta forms
+  struct GodanRow
+  {
+    std::string_view u, a, i, e, o, te, ta;
+  };
+
+  constexpr std::array<GodanRow, 9> GODAN_ROWS = {{
+      {"う", "わ", "い", "え", "お", "って", "った"},
+      {"く", "か", "き", "け", "こ", "いて", "いた"},
+      {"ぐ", "が", "ぎ", "げ", "ご", "いで", "いだ"},
+      {"す", "さ", "し", "せ", "そ", "して", "した"},
+      {"つ", "た", "ち", "て", "と", "って", "った"},
+      {"ぬ", "な", "に", "ね", "の", "んで", "んだ"},
+      {"ぶ", "ば", "び", "べ", "ぼ", "んで", "んだ"},
+      {"む", "ま", "み", "め", "も", "んで", "んだ"},
+      {"る", "ら", "り", "れ", "ろ", "って", "った"},
+  }};
+
+  // Endings shared by every verb once its stem is known: the stem a ます
+  // form is built on, the negative stem and so on come from the callers
+  template <typename Emit>
+  constexpr void masuForms(Emit &emit, std::string_view stem, std::string_view base, Class baseClass)
+  {
+    emit(Form::polite, stem, "ます", base, final, baseClass);
+    emit(Form::politePast, stem, "ました", base, final, baseClass);
+    emit(Form::politeNegative, stem, "ません", base, final, baseClass);
+    emit(Form::politeNegativePast, stem, "ませんでした", base, final, baseClass);
+    emit(Form::politeVolitional, stem, "ましょう", base, final, baseClass);
+    emit(Form::desire, stem, "たい", base, adjective, baseClass);
+  }
+
+  // Every rule, as emit(form, inflected head, inflected tail, base,
+  // inflected class, base class). Run twice: once to count, once to fill.
+  template <typename Emit>
+  constexpr void generateRules(Emit &&emit)
+  {
+    for (const GodanRow &row : GODAN_ROWS)
+    {
+      emit(Form::negative, row.a, "ない", row.u, adjective, godan);
+      emit(Form::negativePast, row.a, "なかった", row.u, final, godan);
+      emit(Form::past, row.ta, "", row.u, final, godan);
+      emit(Form::te, row.te, "", row.u, final | teForm, godan);
+      masuForms(emit, row.i, row.u, godan);
+      emit(Form::volitional, row.o, "う", row.u, final, godan);
+      emit(Form::potential, row.e, "る", row.u, ichidan, godan);
+      emit(Form::passive, row.a, "れる", row.u, ichidan, godan);
+      emit(Form::causative, row.a, "せる", row.u, ichidan, godan);
+      emit(Form::imperative, row.e, "", row.u, final, godan);
+      emit(Form::conditional, row.e, "ば", row.u, final, godan);
+    }
+    // 行く is the one godan verb with an irregular te form
+    for (const std::string_view iku : {"いく", "行く"})
+    {
+      const std::string_view stem = iku.substr(0, iku.size() - std::string_view("く").size());
+      emit(Form::past, stem, "った", iku, final, godan);
+      emit(Form::te, stem, "って", iku, final | teForm, godan);
+    }
+
+    emit(Form::negative, "ない", "", "る", adjective, ichidan);
+    emit(Form::negativePast, "なかった", "", "る", final, ichidan);
+    emit(Form::past, "た", "", "る", final, ichidan);
+    emit(Form::te, "て", "", "る", final | teForm, ichidan);
+    masuForms(emit, "", "る", ichidan);
+    emit(Form::volitional, "よう", "", "る", final, ichidan);
+    emit(Form::potential, "られる", "", "る", ichidan, ichidan);
+    emit(Form::passive, "られる", "", "る", ichidan, ichidan);
+    emit(Form::causative, "させる", "", "る", ichidan, ichidan);
+    emit(Form::imperative, "ろ", "", "る", final, ichidan);
+    emit(Form::conditional, "れば", "", "る", final, ichidan);
+
+    // Stems of 来る by the vowel they take, in kana and in kanji
+    for (const auto &[kuru, ko, ki, ku] : {std::array<std::string_view, 4>{"くる", "こ", "き", "く"},
+                                          std::array<std::string_view, 4>{"来る", "来", "来", "来"}})
+    {
+      emit(Form::negative, ko, "ない", kuru, adjective, Class::kuru);
+      emit(Form::negativePast, ko, "なかった", kuru, final, Class::kuru);
+      emit(Form::past, ki, "た", kuru, final, Class::kuru);
+      emit(Form::te, ki, "て", kuru, final | teForm, Class::kuru);
+      masuForms(emit, ki, kuru, Class::kuru);
+      emit(Form::volitional, ko, "よう", kuru, final, Class::kuru);
+      emit(Form::potential, ko, "られる", kuru, ichidan, Class::kuru);
+      emit(Form::passive, ko, "られる", kuru, ichidan, Class::kuru);
+      emit(Form::causative, ko, "させる", kuru, ichidan, Class::kuru);
+      emit(Form::imperative, ko, "い", kuru, final, Class::kuru);
+      emit(Form::conditional, ku, "れば", kuru, final, Class::kuru);
+    }
+
+    emit(Form::negative, "しない", "", "する", adjective, suru);
+    emit(Form::negativePast, "しなかった", "", "する", final, suru);
+    emit(Form::past, "した", "", "する", final, suru);
+    emit(Form::te, "して", "", "する", final | teForm, suru);
+    masuForms(emit, "し", "する", suru);
+    emit(Form::volitional, "しよう", "", "する", final, suru);
+    emit(Form::potential, "できる", "", "する", ichidan, suru);
+    emit(Form::passive, "される", "", "する", ichidan, suru);
+    emit(Form::causative, "させる", "", "する", ichidan, suru);
+    emit(Form::imperative, "しろ", "", "する", final, suru);
+    emit(Form::conditional, "すれば", "", "する", final, suru);
+
+    // い adjectives, いい inflects from よい
+    for (const auto &[base, stem] : {std::array<std::string_view, 2>{"い", ""}, std::array<std::string_view, 2>{"いい", "よ"}})
+    {
+      emit(Form::negative, stem, "くない", base, adjective, adjective);
+      emit(Form::negativePast, stem, "くなかった", base, final, adjective);
+      emit(Form::past, stem, "かった", base, final, adjective);
+      emit(Form::te, stem, "くて", base, final, adjective);
+      emit(Form::conditional, stem, "ければ", base, final, adjective);
+    }
+
+    // 食べている and its spoken 食べてる go back to the te form first
+    for (const std::string_view te : {"て", "で"})
+    {
+      emit(Form::progressive, te, "いる", te, ichidan, teForm);
+      emit(Form::progressive, te, "る", te, ichidan, teForm);
+    }
+  }
+
+  constexpr size_t countRules()
+  {
+    size_t count = 0;
+    generateRules([&count](auto &&...) { ++count; });
+    return count;
+  }
+
+  constexpr auto RULES = []
+  {
+    std::array<Rule, countRules()> rules{};
+    size_t next = 0;
+    generateRules([&](Form form, std::string_view head, std::string_view tail, std::string_view base, uint16_t inflectedClass,
+                      Class baseClass) { rules[next++] = Rule{Suffix(head, tail), Suffix(base), inflectedClass, baseClass, form}; });
+    return rules;
+  }();
+
+  // Godan verbs ending in る after an い or え row kana, which would pass for
+  // ichidan by their reading. Sorted by writing.
+  constexpr auto GODAN_RU = []
+  {
+    std::array<std::string_view, 40> words = {
+        "入る", "参る", "嘲る", "茂る", "要る", "覆る", "限る", "帰る", "弄る", "散る", "滑る", "照る", "焦る", "知る",
+        "握る", "減る", "捻る", "混じる", "湿る", "練る", "翻る", "罵る", "耽る", "蹴る", "走る", "遮る", "陥る", "切る",
+        "喋る", "甦る", "漲る", "競る", "詰る", "抉る", "毟る", "迸る", "阿る", "脂ぎる", "抓る", "蘇る",
+    };
+    std::sort(words.begin(), words.end());
+    return words;
+  }();
+
+  // The same for words written in kana, by reading. Readings an ichidan verb
+  // shares (いる, かえる, きる, ねる...) are left out, in kana those are more
+  // likely the ichidan one.
+  constexpr auto GODAN_RU_KANA = []
+  {
+    std::array<std::string_view, 36> words = {
+        "はいる", "まいる", "あざける", "しげる", "くつがえる", "かぎる", "いじる", "ちる", "すべる", "てる", "しる", "にぎる",
+        "ひねる", "まじる", "ひるがえる", "ののしる", "ける", "はしる", "さえぎる", "おちいる", "しゃべる", "よみがえる", "みなぎる", "せる",
+        "なじる", "えぐる", "むしる", "ほとばしる", "おもねる", "あぶらぎる", "つねる", "ちぎる", "ねじる", "びびる", "くねる", "うねる",
+    };
+    std::sort(words.begin(), words.end());
+    return words;
+  }();
+
+  constexpr std::string_view I_ROW = "いきぎしじちぢにひびぴみりゐ";
+  constexpr std::string_view E_ROW = "えけげせぜてでねへべぺめれゑ";
+
+  bool inRow(std::string_view row, std::string_view kana)
+  {
+    for (size_t pos = 0; pos + kana.size() <= row.size(); pos += kana.size())
+    {
+      if (row.substr(pos, kana.size()) == kana)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Kana are three bytes in UTF-8
+  constexpr size_t KANA = std::string_view("か").size();
+}
+
+namespace Bot::Inflection
+{
+  std::string_view formName(Form form)
+  {
+    switch (form)
+    {
+    case Form::negative:
+      return "negative";
+    case Form::past:
+      return "past";
+    case Form::negativePast:
+      return "negative past";
+    case Form::te:
+      return "te form";
+    case Form::polite:
+      return "polite";
+    case Form::politePast:
+      return "polite past";
+    case Form::politeNegative:
+      return "polite negative";
+    case Form::politeNegativePast:
+      return "polite negative past";
+    case Form::politeVolitional:
+      return "polite volitional";
+    case Form::volitional:
+      return "volitional";
+    case Form::potential:
+      return "potential";
+    case Form::passive:
+      return "passive";
+    case Form::causative:
+      return "causative";
+    case Form::imperative:
+      return "imperative";
+    case Form::conditional:
+      return "conditional";
+    case Form::desire:
+      return "want to (tai)";
+    case Form::progressive:
+      return "progressive";
+    }
+    return "unknown";
+  }
+
+  std::vector<Deinflection> deinflect(std::string_view text)
+  {
+    // Breadth first, so a form reached in fewer steps is listed first and
+    // the longer paths to it are dropped as duplicates
+    std::vector<Deinflection> found;
+    found.push_back(Deinflection{std::string(text)});
+    for (size_t current = 0; current < found.size(); ++current)
+    {
+      if (found[current].steps == Deinflection::MAX_STEPS)
+      {
+        continue;
+      }
+      for (const Rule &rule : RULES)
+      {
+        const Deinflection &from = found[current];
+        const std::string_view inflected = rule.inflected.view();
+        const std::string_view base = rule.base.view();
+        // An empty stem only makes sense when the base is a whole word: する, くる
+        if (!(from.wordClass & rule.inflectedClass) || !from.word.ends_with(inflected) ||
+            (from.word.size() == inflected.size() && base.size() <= KANA))
+        {
+          continue;
+        }
+        std::string word = from.word.substr(0, from.word.size() - inflected.size());
+        word += base;
+        if (std::any_of(found.begin(), found.end(), [&](const Deinflection &seen)
+                        { return seen.wordClass == rule.baseClass && seen.word == word; }))
+        {
+          continue;
+        }
+        Deinflection next{std::move(word), rule.baseClass, from.forms, static_cast<uint8_t>(from.steps + 1)};
+        next.forms[from.steps] = rule.form;
+        found.push_back(std::move(next));
+      }
+    }
+    // The text itself and te forms waiting for their verb are no dictionary forms
+    std::erase_if(found, [](const Deinflection &deinflection)
+                  { return !deinflection.steps || !(deinflection.wordClass & dictionary); });
+    return found;
+  }
+
+  std::string conjugate(std::string_view word, Class wordClass, Form form)
+  {
+    // 行く's past is the same rule shape as the regular く row, so the
+    // longest base that fits wins
+    const Rule *best = nullptr;
+    for (const Rule &rule : RULES)
+    {
+      if (rule.form == form && rule.baseClass == wordClass && word.ends_with(rule.base.view()) &&
+          (!best || rule.base.size > best->base.size))
+      {
+        best = &rule;
+      }
+    }
+    if (!best)
+    {
+      return {};
+    }
+    std::string result(word.substr(0, word.size() - best->base.size));
+    result += best->inflected.view();
+    return result;
+  }
+
+  Class verbClass(std::string_view writing, std::string_view reading, std::string_view gloss)
+  {
+    if (!gloss.starts_with("to ") || reading.size() < 2 * KANA)
+    {
+      return none;
+    }
+    if (reading.ends_with("する"))
+    {
+      return writing.ends_with("する") ? suru : none;
+    }
+    if (reading == "くる")
+    {
+      return writing == "来る" || writing == "くる" ? kuru : none;
+    }
+    const std::string_view last = reading.substr(reading.size() - KANA);
+    if (!writing.ends_with(last) || std::none_of(GODAN_ROWS.begin(), GODAN_ROWS.end(), [&](const GodanRow &row) { return row.u == last; }))
+    {
+      return none;
+    }
+    const std::string_view before = reading.substr(reading.size() - 2 * KANA, KANA);
+    const bool godanRu = writing == reading ? std::binary_search(GODAN_RU_KANA.begin(), GODAN_RU_KANA.end(), reading)
+                                            : std::binary_search(GODAN_RU.begin(), GODAN_RU.end(), writing);
+    if (last == "る" && (inRow(I_ROW, before) || inRow(E_ROW, before)) && !godanRu)
+    {
+      return ichidan;
+    }
+    return godan;
+  }
+}
\ No newline at end of file
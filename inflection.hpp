@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Bot::Inflection
+{
+  // What a word or form still inflects as, a bit set
+  enum Class : uint16_t
+  {
+    none = 0,
+    ichidan = 1 << 0,   // 食べる
+    godan = 1 << 1,     // 書く
+    kuru = 1 << 2,      // 来る
+    suru = 1 << 3,      // する, 勉強する
+    adjective = 1 << 4, // 高い, also 食べない and 食べたい
+    teForm = 1 << 5,    // 食べて, before いる
+    final = 1 << 6,     // inflects no further
+    dictionary = ichidan | godan | kuru | suru | adjective,
+    any = dictionary | teForm | final,
+  };
+
+  enum class Form : uint8_t
+  {
+    negative,
+    past,
+    negativePast,
+    te,
+    polite,
+    politePast,
+    politeNegative,
+    politeNegativePast,
+    politeVolitional,
+    volitional,
+    potential,
+    passive,
+    causative,
+    imperative,
+    conditional,
+    desire,
+    progressive,
+  };
+
+  std::string_view formName(Form form);
+
+  struct Deinflection
+  {
+    static constexpr size_t MAX_STEPS = 4;
+
+    std::string word;
+    // What word has to be for the deinflection to hold
+    Class wordClass = any;
+    // Outermost first, in the order they were stripped: 食べさせられた is
+    // past, passive, causative
+    std::array<Form, MAX_STEPS> forms{};
+    uint8_t steps = 0;
+  };
+
+  // Dictionary forms text may be an inflection of, fewest steps first.
+  // Built from the same rule table conjugate() uses; nothing is checked
+  // against a dictionary, so most candidates of a long text are not words.
+  std::vector<Deinflection> deinflect(std::string_view text);
+
+  // word, a dictionary form of the given class, put in form. Empty if the
+  // rules have nothing for the class or word doesn't end like it.
+  std::string conjugate(std::string_view word, Class wordClass, Form form);
+
+  // Class of a dictionary word for the conjugation quiz: a verb needs an
+  // English gloss starting with "to " and a writing that ends in the same
+  // kana as its reading. none for anything else.
+  Class verbClass(std::string_view writing, std::string_view reading, std::string_view gloss);
+}
\ No newline at end of file
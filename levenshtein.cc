@@ -0,0 +1,62 @@
+#include "levenshtein.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  // Edit counts are kept in a byte, capped one past the limit
+  constexpr unsigned MAX_EDITS = 8;
+}
+
+namespace Bot
+{
+  char32_t nextCodePoint(std::string_view text, size_t &pos)
+  {
+    const unsigned char lead = text[pos];
+    const size_t length = lead < 0xC0 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+    if (length == 1 || pos + length > text.size())
+    {
+      pos++;
+      return lead;
+    }
+    char32_t c = lead & (0xFF >> (length + 1));
+    for (size_t i = 1; i < length; ++i)
+    {
+      c = (c << 6) | (text[pos + i] & 0x3F);
+    }
+    pos += length;
+    return c;
+  }
+
+  LevenshteinAutomaton::LevenshteinAutomaton(std::string_view query, unsigned maxEdits)
+      : maxEdits_(static_cast<uint8_t>(std::min(maxEdits, MAX_EDITS)))
+  {
+    for (size_t pos = 0; pos < query.size();)
+    {
+      query_.push_back(nextCodePoint(query, pos));
+    }
+  }
+
+  void LevenshteinAutomaton::start(State state) const
+  {
+    for (size_t i = 0; i < state.size(); ++i)
+    {
+      state[i] = static_cast<uint8_t>(std::min<size_t>(i, maxEdits_ + 1));
+    }
+  }
+
+  bool LevenshteinAutomaton::step(ConstState state, char32_t c, State next) const
+  {
+    const uint8_t cap = maxEdits_ + 1;
+    next[0] = std::min<uint8_t>(state[0] + 1, cap);
+    uint8_t best = next[0];
+    for (size_t i = 1; i < next.size(); ++i)
+    {
+      const uint8_t replace = state[i - 1] + (query_[i - 1] != c);
+      const uint8_t edits = std::min({replace, static_cast<uint8_t>(state[i] + 1), static_cast<uint8_t>(next[i - 1] + 1), cap});
+      next[i] = edits;
+      best = std::min(best, edits);
+    }
+    return best <= maxEdits_;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Bot
+{
+  // Decodes the UTF-8 code point at text[pos] and moves pos past it.
+  // Malformed bytes come out one at a time as themselves.
+  char32_t nextCodePoint(std::string_view text, size_t &pos);
+
+  // Levenshtein automaton for one query, over code points so a kana typo
+  // costs one edit like a latin one. A state is the last row of the edit
+  // distance table for the text read so far, capped at maxEdits + 1: a step
+  // costs O(query length), and once no cell is within maxEdits no text
+  // starting with what was read can match, which is what lets a sorted key
+  // list skip whole prefixes.
+  class LevenshteinAutomaton
+  {
+  public:
+    using State = std::span<uint8_t>;
+    using ConstState = std::span<const uint8_t>;
+
+    LevenshteinAutomaton(std::string_view query, unsigned maxEdits);
+
+    // Bytes of one state
+    size_t stateSize() const { return query_.size() + 1; }
+    // Longest text that can still match, in code points
+    size_t maxLength() const { return query_.size() + maxEdits_; }
+
+    void start(State state) const;
+    // Returns false if nothing read from next on can match
+    bool step(ConstState state, char32_t c, State next) const;
+    bool matches(ConstState state) const { return state.back() <= maxEdits_; }
+    unsigned distance(ConstState state) const { return state.back(); }
+
+  private:
+    std::u32string query_;
+    const uint8_t maxEdits_;
+  };
+}
\ No newline at end of file
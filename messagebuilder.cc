@@ -0,0 +1,142 @@
+#include "messagebuilder.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace
+{
+  // Retained by a thread between messages, a larger buffer is released
+  constexpr size_t MAX_RETAINED = 64 * 1024;
+
+  // Bytes each character grows by when escaped, one table per Escape
+  constexpr std::array<std::array<uint8_t, 256>, 3> buildExtra()
+  {
+    std::array<std::array<uint8_t, 256>, 3> extra{};
+    // Every character MarkdownV2 reserves, outside of code entities
+    for (const char c : std::string_view("_*[]()~`>#+-=|{}.!\\"))
+    {
+      extra[static_cast<size_t>(Bot::Escape::markdownV2)][static_cast<unsigned char>(c)] = 1;
+    }
+    auto &html = extra[static_cast<size_t>(Bot::Escape::html)];
+    html['&'] = 4;
+    html['<'] = 3;
+    html['>'] = 3;
+    html['"'] = 5;
+    return extra;
+  }
+
+  constexpr auto EXTRA = buildExtra();
+
+  std::string_view entity(char c)
+  {
+    switch (c)
+    {
+    case '&':
+      return "&amp;";
+    case '<':
+      return "&lt;";
+    case '>':
+      return "&gt;";
+    default:
+      return "&quot;";
+    }
+  }
+
+  std::string &threadBuffer()
+  {
+    thread_local std::string buffer;
+    return buffer;
+  }
+}
+
+namespace Bot
+{
+  size_t escapedSize(std::string_view text, Escape escape)
+  {
+    size_t size = text.size();
+    if (escape != Escape::none)
+    {
+      const auto &extra = EXTRA[static_cast<size_t>(escape)];
+      for (const char c : text)
+      {
+        size += extra[static_cast<unsigned char>(c)];
+      }
+    }
+    return size;
+  }
+
+  size_t escape(std::string_view text, Escape escape, char *out)
+  {
+    const auto &extra = EXTRA[static_cast<size_t>(escape)];
+    char *o = out;
+    // Plain runs are copied whole, only the characters in the table stop them
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+      const char c = text[i];
+      if (!extra[static_cast<unsigned char>(c)])
+      {
+        continue;
+      }
+      std::memcpy(o, text.data() + run, i - run);
+      o += i - run;
+      run = i + 1;
+      if (escape == Escape::markdownV2)
+      {
+        *o++ = '\\';
+        *o++ = c;
+      }
+      else
+      {
+        const std::string_view replacement = entity(c);
+        std::memcpy(o, replacement.data(), replacement.size());
+        o += replacement.size();
+      }
+    }
+    std::memcpy(o, text.data() + run, text.size() - run);
+    return o + text.size() - run - out;
+  }
+
+  MessageBuilder::MessageBuilder(Escape escape)
+      : buffer_(threadBuffer()), begin_(buffer_.size()), escape_(escape)
+  {
+  }
+
+  MessageBuilder::~MessageBuilder()
+  {
+    buffer_.resize(begin_);
+    if (!begin_ && buffer_.capacity() > MAX_RETAINED)
+    {
+      buffer_.shrink_to_fit();
+    }
+  }
+
+  char *MessageBuilder::grow(size_t size)
+  {
+    const size_t used = buffer_.size();
+    buffer_.resize(used + size);
+    return buffer_.data() + used;
+  }
+
+  MessageBuilder &MessageBuilder::raw(std::string_view text)
+  {
+    buffer_.append(text);
+    return *this;
+  }
+
+  MessageBuilder &MessageBuilder::raw(char c)
+  {
+    buffer_.push_back(c);
+    return *this;
+  }
+
+  MessageBuilder &MessageBuilder::text(std::string_view text)
+  {
+    if (escape_ == Escape::none)
+    {
+      return raw(text);
+    }
+    escape(text, escape_, grow(escapedSize(text, escape_)));
+    return *this;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+#include <charconv>
+#include <concepts>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Bot
+{
+  // What text() escapes for, after Telegram's parse modes
+  enum class Escape
+  {
+    none,
+    markdownV2,
+    html,
+  };
+
+  // Size of text once escaped
+  size_t escapedSize(std::string_view text, Escape escape);
+  // Writes the escaped text to out, which must hold escapedSize() bytes,
+  // and returns the number of bytes written
+  size_t escape(std::string_view text, Escape escape, char *out);
+
+  // Renders one outgoing message into a buffer owned by the calling thread,
+  // so building it allocates nothing once the buffer has grown and str()
+  // makes the only copy. Builders on one thread nest: an inner builder
+  // appends after its outer one and gives the space back when destroyed,
+  // so it must be done before the outer one appends again.
+  class MessageBuilder
+  {
+  public:
+    explicit MessageBuilder(Escape escape = Escape::none);
+    ~MessageBuilder();
+    MessageBuilder(const MessageBuilder &) = delete;
+    MessageBuilder &operator=(const MessageBuilder &) = delete;
+
+    // Markup and text that is already safe, as is
+    MessageBuilder &raw(std::string_view text);
+    MessageBuilder &raw(char c);
+    // User or dictionary text, escaped for the parse mode
+    MessageBuilder &text(std::string_view text);
+
+    template <std::integral T>
+    MessageBuilder &number(T value)
+    {
+      char digits[24];
+      const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+      return raw(std::string_view(digits, result.ptr - digits));
+    }
+
+    // Escaped values between raw separators, sized first so the buffer
+    // grows at most once
+    template <typename Range>
+    MessageBuilder &join(const Range &values, std::string_view separator)
+    {
+      size_t total = 0;
+      size_t count = 0;
+      for (const auto &value : values)
+      {
+        total += escapedSize(value, escape_);
+        count++;
+      }
+      if (!count)
+      {
+        return *this;
+      }
+      char *out = grow(total + (count - 1) * separator.size());
+      for (const auto &value : values)
+      {
+        out += escape(value, escape_, out);
+        if (--count)
+        {
+          std::memcpy(out, separator.data(), separator.size());
+          out += separator.size();
+        }
+      }
+      return *this;
+    }
+
+    // Lets writer fill up to capacity bytes in place. It is called with a
+    // std::span<char> and returns how many bytes it used.
+    template <typename Writer>
+    MessageBuilder &write(size_t capacity, Writer writer)
+    {
+      const size_t size = buffer_.size();
+      buffer_.resize(size + capacity);
+      buffer_.resize(size + writer(std::span<char>(buffer_.data() + size, capacity)));
+      return *this;
+    }
+
+    std::string_view view() const { return std::string_view(buffer_).substr(begin_); }
+    size_t size() const { return buffer_.size() - begin_; }
+    bool empty() const { return size() == 0; }
+    std::string str() const { return std::string(view()); }
+
+  private:
+    // Appends size bytes to the message and returns where they start
+    char *grow(size_t size);
+
+    std::string &buffer_;
+    const size_t begin_;
+    const Escape escape_;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace Bot
+{
+  // Unbounded intrusive multi-producer single-consumer queue (Vyukov). push()
+  // is wait-free for producers; only the consumer may call pop()/waitPop().
+  // After close() push() refuses items, every item it accepted is delivered.
+  template <typename T>
+  class MpscQueue
+  {
+  public:
+    MpscQueue()
+        : head_(new Node), tail_(head_.load(std::memory_order_relaxed))
+    {
+    }
+
+    ~MpscQueue()
+    {
+      T discarded;
+      while (pop(discarded))
+      {
+      }
+      delete tail_;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    bool push(T value)
+    {
+      // Announced before closed_ is checked so close() can wait for this push
+      pushing_.fetch_add(1, std::memory_order_seq_cst);
+      if (closed_.load(std::memory_order_seq_cst))
+      {
+        done();
+        return false;
+      }
+      Node *node = new Node;
+      node->value = std::move(value);
+      Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+      prev->next.store(node, std::memory_order_release);
+      size_.fetch_add(1, std::memory_order_relaxed);
+      signal_.fetch_add(1, std::memory_order_release);
+      signal_.notify_one();
+      done();
+      return true;
+    }
+
+    bool pop(T &value)
+    {
+      Node *tail = tail_;
+      Node *next = tail->next.load(std::memory_order_acquire);
+      if (!next)
+      {
+        return false;
+      }
+      value = std::move(next->value);
+      tail_ = next;
+      delete tail;
+      size_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Blocks until an item arrives or close() is called. Items pushed before
+    // close() are still delivered.
+    bool waitPop(T &value)
+    {
+      while (true)
+      {
+        const uint64_t seen = signal_.load(std::memory_order_acquire);
+        if (pop(value))
+        {
+          return true;
+        }
+        if (drained_.load(std::memory_order_acquire))
+        {
+          return false;
+        }
+        signal_.wait(seen, std::memory_order_acquire);
+      }
+    }
+
+    void close()
+    {
+      closed_.store(true, std::memory_order_seq_cst);
+      // Pushes that got past the closed_ check finish linking their node first
+      for (uint32_t pushing = pushing_.load(std::memory_order_seq_cst); pushing; pushing = pushing_.load(std::memory_order_seq_cst))
+      {
+        pushing_.wait(pushing, std::memory_order_seq_cst);
+      }
+      drained_.store(true, std::memory_order_release);
+      signal_.fetch_add(1, std::memory_order_release);
+      signal_.notify_all();
+    }
+
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+  private:
+    void done()
+    {
+      if (pushing_.fetch_sub(1, std::memory_order_seq_cst) == 1 && closed_.load(std::memory_order_seq_cst))
+      {
+        pushing_.notify_all();
+      }
+    }
+
+    struct Node
+    {
+      std::atomic<Node *> next = nullptr;
+      T value;
+    };
+
+    std::atomic<Node *> head_;
+    Node *tail_;
+    std::atomic<uint64_t> signal_ = 0;
+    std::atomic<size_t> size_ = 0;
+    std::atomic<uint32_t> pushing_ = 0;
+    std::atomic<bool> closed_ = false;
+    // Set by close() once no push can still add an item
+    std::atomic<bool> drained_ = false;
+  };
+}
\ No newline at end of file
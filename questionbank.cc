@@ -0,0 +1,345 @@
+#include "questionbank.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <unordered_set>
+
+namespace
+{
+  // JlptTraining only hands out random draws, so pools it can't be asked
+  // for are collected by drawing until this many draws in a row (at least)
+  // brought nothing new.
+  constexpr size_t HARVEST_PATIENCE = 2000;
+  constexpr size_t HARVEST_CAP = 200000;
+  constexpr size_t KANA_POOL = 512;
+
+  std::mt19937 &generator()
+  {
+    thread_local std::mt19937 gen(std::random_device{}());
+    return gen;
+  }
+
+  uint32_t pick(size_t size)
+  {
+    return std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(size - 1))(generator());
+  }
+
+  template <typename T, typename Draw>
+  std::vector<T> harvest(Draw draw, size_t cap = HARVEST_CAP)
+  {
+    std::unordered_set<T> seen;
+    std::vector<T> result;
+    size_t misses = 0;
+    while (result.size() < cap && misses < std::max(HARVEST_PATIENCE, 4 * result.size()))
+    {
+      T value = draw();
+      if (value == T() || !seen.insert(value).second)
+      {
+        misses++;
+        continue;
+      }
+      misses = 0;
+      result.push_back(std::move(value));
+    }
+    return result;
+  }
+
+  // Every distinct headword of the image in entry order: the writings, or
+  // the first reading of an entry written in kana only
+  std::vector<std::string> headwords(const Bot::DictionaryImage &image)
+  {
+    std::unordered_set<std::string_view> seen;
+    std::vector<std::string> result;
+    for (uint32_t entry = 0; entry < image.size(); ++entry)
+    {
+      auto refs = image.values(entry, Bot::DictImage::writing);
+      if (refs.empty())
+      {
+        const auto readings = image.values(entry, Bot::DictImage::reading);
+        refs = readings.first(std::min<size_t>(1, readings.size()));
+      }
+      for (const Bot::DictImage::StringRef &ref : refs)
+      {
+        const std::string_view word = image.string(ref);
+        if (seen.insert(word).second)
+        {
+          result.emplace_back(word);
+        }
+      }
+    }
+    return result;
+  }
+
+  bool isSmallKana(char32_t c)
+  {
+    switch (c)
+    {
+    case U'ぁ': case U'ぃ': case U'ぅ': case U'ぇ': case U'ぉ':
+    case U'ゃ': case U'ゅ': case U'ょ': case U'ゎ':
+    case U'ァ': case U'ィ': case U'ゥ': case U'ェ': case U'ォ':
+    case U'ャ': case U'ュ': case U'ョ': case U'ヮ':
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  // Small ya/yu/yo and vowels fuse with the preceding kana into one mora
+  size_t moraCount(std::string_view reading)
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < reading.size();)
+    {
+      const unsigned char lead = reading[i];
+      const size_t length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+      char32_t c = length == 1 ? lead : lead & (0xFF >> (length + 1));
+      for (size_t j = 1; j < length && i + j < reading.size(); ++j)
+      {
+        c = (c << 6) | (reading[i + j] & 0x3F);
+      }
+      count += !isSmallKana(c);
+      i += length;
+    }
+    return count;
+  }
+
+  size_t wordCount(std::string_view gloss)
+  {
+    return 1 + std::count(gloss.begin(), gloss.end(), ' ');
+  }
+
+  struct Span
+  {
+    uint32_t offset;
+    uint32_t length;
+  };
+}
+
+namespace Bot
+{
+  QuestionBank::Level::Level(unsigned jlpt, const DictionaryImage *image)
+  {
+    const auto started = std::chrono::steady_clock::now();
+    training_ = jlpt == DEFAULT_LEVEL ? std::make_unique<Training::JlptTraining>() : std::make_unique<Training::JlptTraining>(jlpt);
+
+    // Views are taken once the arena stops growing
+    auto intern = [this](const std::string &text)
+    {
+      Span span{static_cast<uint32_t>(arena_.size()), static_cast<uint32_t>(text.size())};
+      arena_ += text;
+      return span;
+    };
+
+    std::vector<Span> words, readings, glosses, counterMeanings;
+    std::array<std::vector<Span>, MAX_KANA_LENGTH + 1> kanaWords;
+
+    // Headwords outside the level have no readings in its training
+    const std::vector<std::string> candidates = image ? headwords(*image) : harvest<std::string>([this]
+                                                                                               { return training_->getRandomWord(); });
+    for (const std::string &word : candidates)
+    {
+      auto wordReadings = training_->getWordReadings(word);
+      auto wordGlosses = training_->getWordTranslations(word);
+      if (wordReadings.empty() || wordGlosses.empty())
+      {
+        continue;
+      }
+
+      words.push_back(intern(word));
+      readingBegin_.push_back(static_cast<uint32_t>(readings.size()));
+      for (const auto &reading : wordReadings)
+      {
+        readings.push_back(intern(reading));
+      }
+      glossBegin_.push_back(static_cast<uint32_t>(glosses.size()));
+      for (const auto &gloss : wordGlosses)
+      {
+        glosses.push_back(intern(gloss));
+      }
+    }
+    readingBegin_.push_back(static_cast<uint32_t>(readings.size()));
+    glossBegin_.push_back(static_cast<uint32_t>(glosses.size()));
+
+    std::uniform_real_distribution<float> floatDist(0.0, 1.0);
+    for (size_t length = MIN_KANA_LENGTH; length <= MAX_KANA_LENGTH; ++length)
+    {
+      auto draw = [this, length, &floatDist]
+      { return training_->getRandomKanaWord(length, floatDist(generator())); };
+      for (const std::string &kana : harvest<std::string>(draw, KANA_POOL))
+      {
+        kanaWords[length].push_back(intern(kana));
+      }
+    }
+
+    audioExamples_ = harvest<uint32_t>([this]
+                                       { return training_->getRandomAudioExampleIDForLevel(); });
+
+    for (uint32_t id : harvest<uint32_t>([this]
+                                         { return training_->getRandomCounterSuffix(); }))
+    {
+      auto meanings = training_->getCounterDescription(id);
+      if (meanings.empty())
+      {
+        continue;
+      }
+      counterIDs_.push_back(id);
+      counterMeanings.push_back(intern(meanings.front()));
+    }
+
+    arena_.shrink_to_fit();
+    auto views = [this](const std::vector<Span> &spans, std::vector<std::string_view> &target)
+    {
+      target.reserve(spans.size());
+      for (const Span &span : spans)
+      {
+        target.emplace_back(arena_.data() + span.offset, span.length);
+      }
+    };
+    views(words, words_);
+    views(readings, readings_);
+    views(glosses, glosses_);
+    views(counterMeanings, counterMeanings_);
+    for (size_t length = MIN_KANA_LENGTH; length <= MAX_KANA_LENGTH; ++length)
+    {
+      views(kanaWords[length], kanaWords_[length]);
+    }
+    buildPools(QuizField::reading);
+    buildPools(QuizField::gloss);
+
+    const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+    LOG_INFO("JLPT level {} loaded in {}ms: {} words ({} from {} candidates), {} audio examples, {} counters, {} bytes\n",
+             jlpt, elapsedMs, words_.size(), image ? "image" : "draws", candidates.size(), audioExamples_.size(), counterIDs_.size(), memoryUsage());
+  }
+
+  void QuestionBank::Level::buildPools(QuizField field)
+  {
+    DistractorPools &target = field == QuizField::reading ? readingPools_ : glossPools_;
+    target.bucket.resize(words_.size());
+    for (uint32_t index = 0; index < words_.size(); ++index)
+    {
+      const std::string_view text = answer(index, field);
+      const size_t shape = field == QuizField::reading ? moraCount(text) : wordCount(text);
+      target.bucket[index] = static_cast<uint8_t>(std::min(shape, POOL_BUCKETS - 1));
+      target.words[target.bucket[index]].push_back(index);
+    }
+    for (auto &words : target.words)
+    {
+      if (words.size() < MIN_POOL_SIZE)
+      {
+        words.clear();
+      }
+      words.shrink_to_fit();
+    }
+  }
+
+  std::string_view QuestionBank::Level::answer(uint32_t index, QuizField field) const
+  {
+    return field == QuizField::reading ? readings_[readingBegin_[index]] : glosses_[glossBegin_[index]];
+  }
+
+  QuestionBank::QuizOptions QuestionBank::Level::quizOptions(uint32_t index, QuizField field, size_t count) const
+  {
+    const auto own = field == QuizField::reading ? readings(index) : glosses(index);
+    const std::string_view correct = own.front();
+    const auto &pool = pools(field).words[pools(field).bucket[index]];
+
+    std::vector<std::string_view> distractors;
+    distractors.reserve(count);
+    for (size_t attempts = 0; distractors.size() + 1 < count && attempts < count * 16; ++attempts)
+    {
+      const uint32_t other = pool.empty() ? randomWord() : pool[pick(pool.size())];
+      const std::string_view option = answer(other, field);
+      // A synonym of the answer would make the question ambiguous
+      if (other == index || std::find(own.begin(), own.end(), option) != own.end() || std::find(distractors.begin(), distractors.end(), option) != distractors.end())
+      {
+        continue;
+      }
+      distractors.push_back(option);
+    }
+
+    QuizOptions result;
+    if (distractors.empty())
+    {
+      return result;
+    }
+    // Distractors come out of the pool in random order, only the answer needs a slot
+    result.correct = static_cast<int32_t>(pick(distractors.size() + 1));
+    distractors.insert(distractors.begin() + result.correct, correct);
+    result.options.assign(distractors.begin(), distractors.end());
+    return result;
+  }
+
+  uint32_t QuestionBank::Level::randomWord() const
+  {
+    return words_.empty() ? NONE : pick(words_.size());
+  }
+
+  std::span<const std::string_view> QuestionBank::Level::readings(uint32_t index) const
+  {
+    return std::span<const std::string_view>(readings_).subspan(readingBegin_[index], readingBegin_[index + 1] - readingBegin_[index]);
+  }
+
+  std::span<const std::string_view> QuestionBank::Level::glosses(uint32_t index) const
+  {
+    return std::span<const std::string_view>(glosses_).subspan(glossBegin_[index], glossBegin_[index + 1] - glossBegin_[index]);
+  }
+
+  std::string_view QuestionBank::Level::randomKanaWord(size_t length) const
+  {
+    length = std::clamp(length, MIN_KANA_LENGTH, MAX_KANA_LENGTH);
+    const auto &pool = kanaWords_[length];
+    return pool.empty() ? std::string_view() : pool[pick(pool.size())];
+  }
+
+  uint32_t QuestionBank::Level::randomAudioExample() const
+  {
+    return audioExamples_.empty() ? 0 : audioExamples_[pick(audioExamples_.size())];
+  }
+
+  uint32_t QuestionBank::Level::randomCounter() const
+  {
+    return counterIDs_.empty() ? NONE : pick(counterIDs_.size());
+  }
+
+  uint64_t QuestionBank::Level::randomNumber() const
+  {
+    std::lock_guard<std::mutex> lock(trainingMutex_);
+    return training_->getRandomNumber();
+  }
+
+  std::string QuestionBank::Level::numberString(uint64_t number) const
+  {
+    std::lock_guard<std::mutex> lock(trainingMutex_);
+    return training_->getNumberString(number);
+  }
+
+  size_t QuestionBank::Level::memoryUsage() const
+  {
+    size_t total = arena_.capacity();
+    total += (words_.capacity() + readings_.capacity() + glosses_.capacity() + counterMeanings_.capacity()) * sizeof(std::string_view);
+    total += (readingBegin_.capacity() + glossBegin_.capacity() + audioExamples_.capacity() + counterIDs_.capacity()) * sizeof(uint32_t);
+    for (const auto &pool : kanaWords_)
+    {
+      total += pool.capacity() * sizeof(std::string_view);
+    }
+    for (const DistractorPools *pools : {&readingPools_, &glossPools_})
+    {
+      total += pools->bucket.capacity();
+      for (const auto &words : pools->words)
+      {
+        total += words.capacity() * sizeof(uint32_t);
+      }
+    }
+    return total;
+  }
+
+  const QuestionBank::Level &QuestionBank::level(unsigned jlpt)
+  {
+    Slot &slot = levels_[std::min(jlpt, MAX_LEVEL)];
+    std::call_once(slot.once, [this, &slot, jlpt]()
+                   { slot.level = std::make_unique<Level>(std::min(jlpt, MAX_LEVEL), image_); });
+    return *slot.level;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "dictionaryimage.hpp"
+#include "waka.hpp"
+
+namespace Bot
+{
+  // Immutable per-level snapshot of the JLPT training data. Each level is
+  // built once from a single JlptTraining instance and stored as flat arrays
+  // over one string arena, so drawing a question is a few random index
+  // lookups and any number of threads can read it without locking.
+  // With a dictionary image the vocabulary is every image headword the
+  // level's training has readings and glosses for; without one it is
+  // sampled from the training's random draws.
+  class QuestionBank
+  {
+  public:
+    using Ptr = std::unique_ptr<QuestionBank>;
+
+    // Library default level, what a default-constructed JlptTraining uses
+    static constexpr unsigned DEFAULT_LEVEL = 0;
+    static constexpr unsigned MAX_LEVEL = 5;
+    // Level the word, kana and numeral quizzes are drawn from
+    static constexpr unsigned QUIZ_LEVEL = 5;
+    static constexpr size_t MIN_KANA_LENGTH = 3;
+    static constexpr size_t MAX_KANA_LENGTH = 8;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    enum class QuizField
+    {
+      reading,
+      gloss,
+    };
+
+    struct QuizOptions
+    {
+      std::vector<std::string> options;
+      int32_t correct = -1;
+    };
+
+    class Level
+    {
+    public:
+      Level(unsigned jlpt, const DictionaryImage *image);
+      Level(const Level &) = delete;
+      Level &operator=(const Level &) = delete;
+
+      size_t size() const { return words_.size(); }
+      uint32_t randomWord() const;
+      std::string_view word(uint32_t index) const { return words_[index]; }
+      std::span<const std::string_view> readings(uint32_t index) const;
+      std::span<const std::string_view> glosses(uint32_t index) const;
+      // The word's first reading or gloss at a random position among up to
+      // count - 1 distractors drawn from words of the same shape
+      QuizOptions quizOptions(uint32_t index, QuizField field, size_t count) const;
+
+      std::string_view randomKanaWord(size_t length) const;
+      uint32_t randomAudioExample() const;
+      std::span<const uint32_t> audioExamples() const { return audioExamples_; }
+
+      size_t counters() const { return counterIDs_.size(); }
+      uint32_t randomCounter() const;
+      uint32_t counterID(uint32_t index) const { return counterIDs_[index]; }
+      std::string_view counterMeaning(uint32_t index) const { return counterMeanings_[index]; }
+
+      // Numerals are computed by the library, the instance is shared under a lock
+      uint64_t randomNumber() const;
+      std::string numberString(uint64_t number) const;
+
+      size_t memoryUsage() const;
+
+    private:
+      // Readings are grouped by mora count, glosses by word count
+      static constexpr size_t POOL_BUCKETS = 9;
+      // Smaller groups would repeat the same distractors, their words draw from the whole level
+      static constexpr size_t MIN_POOL_SIZE = 16;
+
+      struct DistractorPools
+      {
+        std::vector<uint8_t> bucket;
+        std::array<std::vector<uint32_t>, POOL_BUCKETS> words;
+      };
+
+      void buildPools(QuizField field);
+      const DistractorPools &pools(QuizField field) const { return field == QuizField::reading ? readingPools_ : glossPools_; }
+      std::string_view answer(uint32_t index, QuizField field) const;
+
+      std::string arena_;
+      std::vector<std::string_view> words_;
+      std::vector<uint32_t> readingBegin_;
+      std::vector<std::string_view> readings_;
+      std::vector<uint32_t> glossBegin_;
+      std::vector<std::string_view> glosses_;
+      std::array<std::vector<std::string_view>, MAX_KANA_LENGTH + 1> kanaWords_;
+      std::vector<uint32_t> audioExamples_;
+      std::vector<uint32_t> counterIDs_;
+      std::vector<std::string_view> counterMeanings_;
+      DistractorPools readingPools_;
+      DistractorPools glossPools_;
+
+      mutable std::mutex trainingMutex_;
+      Training::JlptTraining::Ptr training_;
+    };
+
+    // image may be null, it has to outlive the bank
+    explicit QuestionBank(const DictionaryImage *image = nullptr) : image_(image) {}
+    QuestionBank(const QuestionBank &) = delete;
+    QuestionBank &operator=(const QuestionBank &) = delete;
+
+    // Builds the level on first use; throws what JlptTraining throws.
+    const Level &level(unsigned jlpt);
+
+  private:
+    struct Slot
+    {
+      std::once_flag once;
+      std::unique_ptr<Level> level;
+    };
+
+    const DictionaryImage *image_;
+    std::array<Slot, MAX_LEVEL + 1> levels_;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "quizstats.hpp"
+#include "log.hpp"
+
+namespace
+{
+  constexpr const char *const UPSERT_SCORE =
+      "INSERT INTO Quiz (UserID, KanaReadingCorrect, KanaReadingTotal, WordReadingCorrect, WordReadingTotal, WordMeaningCorrect, WordMeaningTotal, RandomCorrect, RandomTotal) "
+      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?) "
+      "ON CONFLICT(UserID) DO UPDATE SET "
+      "KanaReadingCorrect = KanaReadingCorrect + excluded.KanaReadingCorrect, "
+      "KanaReadingTotal = KanaReadingTotal + excluded.KanaReadingTotal, "
+      "WordReadingCorrect = WordReadingCorrect + excluded.WordReadingCorrect, "
+      "WordReadingTotal = WordReadingTotal + excluded.WordReadingTotal, "
+      "WordMeaningCorrect = WordMeaningCorrect + excluded.WordMeaningCorrect, "
+      "WordMeaningTotal = WordMeaningTotal + excluded.WordMeaningTotal, "
+      "RandomCorrect = RandomCorrect + excluded.RandomCorrect, "
+      "RandomTotal = RandomTotal + excluded.RandomTotal;";
+}
+
+namespace Bot
+{
+  QuizStatsRecorder::QuizStatsRecorder(SQLite::Database &db, StatementPool &statements, std::chrono::milliseconds interval, size_t maxEvents)
+      : db_(db), statements_(statements), interval_(interval), maxEvents_(maxEvents ? maxEvents : 1)
+  {
+    thread_ = std::thread(&QuizStatsRecorder::run, this);
+  }
+
+  QuizStatsRecorder::~QuizStatsRecorder()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    flush();
+  }
+
+  void QuizStatsRecorder::record(int64_t userID, QuizKind kind, bool correct)
+  {
+    const size_t index = static_cast<size_t>(kind);
+    bool full = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Score &score = pending_[userID];
+      score.total[index]++;
+      score.correct[index] += correct;
+      full = ++events_ >= maxEvents_;
+    }
+    recorded_++;
+    if (full)
+    {
+      cv_.notify_one();
+    }
+  }
+
+  void QuizStatsRecorder::run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+      cv_.wait_for(lock, interval_, [this]
+                   { return stopping_ || events_ >= maxEvents_; });
+      if (stopping_)
+      {
+        return;
+      }
+      lock.unlock();
+      flush();
+      lock.lock();
+    }
+  }
+
+  void QuizStatsRecorder::flush()
+  {
+    Batch batch;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (pending_.empty())
+      {
+        return;
+      }
+      batch.swap(pending_);
+      events_ = 0;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    try
+    {
+      write(batch);
+    }
+    catch (const SQLite::Exception &e)
+    {
+      LOG_EXCEPTION("Failed to flush quiz statistics", e);
+      failedFlushes_++;
+      // Put the increments back so the next flush retries them
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto &[userID, score] : batch)
+      {
+        Score &merged = pending_[userID];
+        for (size_t i = 0; i < KINDS; ++i)
+        {
+          merged.correct[i] += score.correct[i];
+          merged.total[i] += score.total[i];
+        }
+      }
+      return;
+    }
+
+    const uint64_t flushUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+    flushes_++;
+    if (flushUs > maxFlushUs_)
+    {
+      maxFlushUs_ = flushUs;
+    }
+    LOG_DEBUG("Flushed quiz statistics of {} users in {}us\n", batch.size(), flushUs);
+  }
+
+  void QuizStatsRecorder::write(const Batch &batch)
+  {
+    SQLite::Transaction transaction(db_);
+    for (const auto &[userID, score] : batch)
+    {
+      auto upsert = statements_.acquire(UPSERT_SCORE);
+      upsert->bind(1, userID);
+      for (size_t i = 0; i < KINDS; ++i)
+      {
+        upsert->bind(static_cast<int>(2 + 2 * i), score.correct[i]);
+        upsert->bind(static_cast<int>(3 + 2 * i), score.total[i]);
+      }
+      upsert->exec();
+    }
+    transaction.commit();
+  }
+
+  QuizStatsRecorder::Stats QuizStatsRecorder::stats() const
+  {
+    Stats result;
+    result.recorded = recorded_;
+    result.flushes = flushes_;
+    result.failedFlushes = failedFlushes_;
+    result.maxFlushUs = maxFlushUs_;
+    return result;
+  }
+}
\ No newline at end of file
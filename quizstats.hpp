@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "statementpool.hpp"
+
+namespace Bot
+{
+  // Quiz kinds that have score columns in the Quiz table
+  enum class QuizKind
+  {
+    kanaReading,
+    wordReading,
+    wordMeaning,
+    random,
+  };
+
+  // Write-behind recorder for quiz scores. record() only bumps in-memory
+  // counters; a background thread folds them into the Quiz table in one
+  // transaction every `interval` or as soon as `maxEvents` answers piled up.
+  class QuizStatsRecorder
+  {
+  public:
+    using Ptr = std::unique_ptr<QuizStatsRecorder>;
+
+    struct Stats
+    {
+      uint64_t recorded = 0;
+      uint64_t flushes = 0;
+      uint64_t failedFlushes = 0;
+      uint64_t maxFlushUs = 0;
+    };
+
+    QuizStatsRecorder(SQLite::Database &db, StatementPool &statements, std::chrono::milliseconds interval, size_t maxEvents);
+    ~QuizStatsRecorder();
+    QuizStatsRecorder(const QuizStatsRecorder &) = delete;
+    QuizStatsRecorder &operator=(const QuizStatsRecorder &) = delete;
+
+    void record(int64_t userID, QuizKind kind, bool correct);
+    Stats stats() const;
+
+  private:
+    static constexpr size_t KINDS = 4;
+
+    struct Score
+    {
+      std::array<uint32_t, KINDS> correct = {};
+      std::array<uint32_t, KINDS> total = {};
+    };
+    using Batch = std::unordered_map<int64_t, Score>;
+
+    void run();
+    // Only the thread and, once it has stopped, the destructor flush
+    void flush();
+    void write(const Batch &batch);
+
+    SQLite::Database &db_;
+    StatementPool &statements_;
+    const std::chrono::milliseconds interval_;
+    const size_t maxEvents_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    Batch pending_;
+    size_t events_ = 0;
+    bool stopping_ = false;
+    std::thread thread_;
+
+    std::atomic<uint64_t> recorded_ = 0;
+    std::atomic<uint64_t> flushes_ = 0;
+    std::atomic<uint64_t> failedFlushes_ = 0;
+    std::atomic<uint64_t> maxFlushUs_ = 0;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "quizstore.hpp"
+
+namespace Bot
+{
+  QuizStore::QuizStore(size_t capacity, std::chrono::seconds ttl)
+      : capacity_(std::min<size_t>(capacity, NONE)), ttl_(ttl), chunks_(std::make_unique<std::atomic<Slot *>[]>((capacity_ + CHUNK - 1) / CHUNK))
+  {
+    for (size_t i = 0; i < (capacity_ + CHUNK - 1) / CHUNK; ++i)
+    {
+      chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  int64_t QuizStore::deadline() const
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>((Clock::now() + ttl_).time_since_epoch()).count();
+  }
+
+  QuizStore::Slot *QuizStore::slot(uint32_t index) const
+  {
+    return &chunks_[index / CHUNK].load(std::memory_order_acquire)[index % CHUNK];
+  }
+
+  QuizStore::Slot *QuizStore::get(Handle handle) const
+  {
+    if (handle.index == NONE || handle.index >= allocated_.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+    Slot *result = slot(handle.index);
+    if (!result->used.load(std::memory_order_acquire) || result->generation.load(std::memory_order_acquire) != handle.generation)
+    {
+      return nullptr;
+    }
+    return result;
+  }
+
+  QuizStore::Slot *QuizStore::acquire(int64_t userID, Handle &handle)
+  {
+    // The user's previous quiz gives its slot back first
+    release(handle);
+
+    uint32_t index = NONE;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (freeList_ != NONE)
+      {
+        index = freeList_;
+        freeList_ = slot(index)->nextFree;
+      }
+      else if (allocated_ < capacity_)
+      {
+        index = static_cast<uint32_t>(allocated_);
+        if (index % CHUNK == 0)
+        {
+          storage_.push_back(std::make_unique<Slot[]>(CHUNK));
+          chunks_[index / CHUNK].store(storage_.back().get(), std::memory_order_release);
+        }
+        allocated_.store(index + 1, std::memory_order_release);
+      }
+    }
+    if (index == NONE)
+    {
+      rejected_++;
+      return nullptr;
+    }
+
+    Slot *result = slot(index);
+    result->userID.store(userID, std::memory_order_relaxed);
+    result->deadline.store(deadline(), std::memory_order_relaxed);
+    result->used.store(true, std::memory_order_release);
+    handle = {index, result->generation.load(std::memory_order_relaxed)};
+    active_++;
+    started_++;
+    return result;
+  }
+
+  void QuizStore::release(Handle &handle)
+  {
+    Slot *result = get(handle);
+    const uint32_t index = handle.index;
+    handle = Handle();
+    if (!result)
+    {
+      return;
+    }
+
+    // Old handles stop matching before the slot can be handed out again
+    result->generation.fetch_add(1, std::memory_order_release);
+    result->used.store(false, std::memory_order_release);
+    result->state = std::monostate();
+    active_--;
+    std::lock_guard<std::mutex> lock(mutex_);
+    result->nextFree = freeList_;
+    freeList_ = index;
+  }
+
+  void QuizStore::finish(Handle &handle)
+  {
+    release(handle);
+  }
+
+  bool QuizStore::expire(Handle &handle)
+  {
+    Slot *result = get(handle);
+    if (!result || result->deadline.load(std::memory_order_relaxed) > std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count())
+    {
+      return false;
+    }
+    release(handle);
+    expired_++;
+    return true;
+  }
+
+  void QuizStore::sweep(const Expired &expired) const
+  {
+    const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    const size_t allocated = allocated_.load(std::memory_order_acquire);
+    for (size_t index = 0; index < allocated; ++index)
+    {
+      const Slot *current = slot(static_cast<uint32_t>(index));
+      if (current->used.load(std::memory_order_acquire) && current->deadline.load(std::memory_order_relaxed) <= now)
+      {
+        expired(current->userID.load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+  QuizStore::Stats QuizStore::stats() const
+  {
+    Stats result;
+    result.active = active_;
+    result.allocated = allocated_;
+    result.capacity = capacity_;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      result.bytes = storage_.size() * CHUNK * sizeof(Slot);
+    }
+    result.started = started_;
+    result.expired = expired_;
+    result.rejected = rejected_;
+    return result;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace Bot
+{
+  struct KanaQuiz
+  {
+    // Points into the question bank, which outlives every quiz
+    std::string_view kana;
+  };
+
+  struct NumeralsQuiz
+  {
+    // Keyboard presses beyond this are ignored
+    static constexpr size_t MAX_REPLY = 64;
+
+    uint64_t number = 0;
+    std::string answer;
+    std::string reply;
+    int32_t inputMessageID = 0;
+    int32_t outputMessageID = 0;
+  };
+
+  using QuizState = std::variant<std::monostate, KanaQuiz, NumeralsQuiz>;
+
+  // Quiz state of every user in one bounded slab. A user's session holds a
+  // handle (slot index and generation), so lookups are a single index and a
+  // finished or expired quiz can't be reached through an old handle. Slots
+  // are allocated in chunks up to the capacity and recycled through a free
+  // list. A slot's state belongs to its user's strand. The periodic sweep
+  // only reads deadlines and leaves the actual expiry to that strand.
+  class QuizStore
+  {
+  public:
+    using Ptr = std::unique_ptr<QuizStore>;
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Handle
+    {
+      uint32_t index = NONE;
+      uint32_t generation = 0;
+    };
+
+    // Called by sweep() for every quiz idle past the TTL
+    using Expired = std::function<void(int64_t userID)>;
+
+    struct Stats
+    {
+      size_t active = 0;
+      size_t allocated = 0;
+      size_t capacity = 0;
+      size_t bytes = 0;
+      uint64_t started = 0;
+      uint64_t expired = 0;
+      uint64_t rejected = 0;
+    };
+
+    QuizStore(size_t capacity, std::chrono::seconds ttl);
+    QuizStore(const QuizStore &) = delete;
+    QuizStore &operator=(const QuizStore &) = delete;
+
+    // Replaces the quiz the handle pointed to. Returns nullptr if every slot
+    // holds a live quiz.
+    template <typename T>
+    T *start(int64_t userID, Handle &handle, T state)
+    {
+      Slot *slot = acquire(userID, handle);
+      return slot ? &slot->state.emplace<T>(std::move(state)) : nullptr;
+    }
+
+    // nullptr if the quiz is over or is another game. Restarts the TTL.
+    template <typename T>
+    T *find(Handle handle)
+    {
+      Slot *slot = get(handle);
+      if (!slot)
+      {
+        return nullptr;
+      }
+      slot->deadline.store(deadline(), std::memory_order_relaxed);
+      return std::get_if<T>(&slot->state);
+    }
+
+    void finish(Handle &handle);
+    // Ends the quiz if it is still idle past the TTL, returns true if it did
+    bool expire(Handle &handle);
+    void sweep(const Expired &expired) const;
+    Stats stats() const;
+
+  private:
+    static constexpr size_t CHUNK = 1024;
+
+    struct Slot
+    {
+      std::atomic<uint32_t> generation = 0;
+      std::atomic<bool> used = false;
+      std::atomic<int64_t> deadline = 0;
+      std::atomic<int64_t> userID = 0;
+      uint32_t nextFree = NONE;
+      QuizState state;
+    };
+
+    int64_t deadline() const;
+    Slot *slot(uint32_t index) const;
+    Slot *get(Handle handle) const;
+    Slot *acquire(int64_t userID, Handle &handle);
+    void release(Handle &handle);
+
+    const size_t capacity_;
+    const std::chrono::seconds ttl_;
+    // Chunk pointers are published once and never move, readers need no lock
+    std::unique_ptr<std::atomic<Slot *>[]> chunks_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Slot[]>> storage_;
+    uint32_t freeList_ = NONE;
+    std::atomic<size_t> allocated_ = 0;
+
+    std::atomic<size_t> active_ = 0;
+    std::atomic<uint64_t> started_ = 0;
+    std::atomic<uint64_t> expired_ = 0;
+    std::atomic<uint64_t> rejected_ = 0;
+  };
+}
\ No newline at end of file
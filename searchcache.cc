@@ -0,0 +1,117 @@
+#include "searchcache.hpp"
+#include "dictimageformat.hpp"
+
+#include <algorithm>
+
+namespace Bot
+{
+  SearchCache::Result::Result(std::vector<uint32_t> ids, size_t pageSize, std::atomic<size_t> &bytes)
+      : ids_(std::move(ids)), pageSize_(pageSize), lines_(ids_.size()),
+        rendered_(std::make_unique<std::once_flag[]>(ids_.size() / pageSize_ + 1)), bytes_(bytes)
+  {
+    size_ = sizeof(Result) + ids_.size() * (sizeof(uint32_t) + sizeof(std::string)) + (ids_.size() / pageSize_ + 1) * sizeof(std::once_flag);
+    bytes_ += size_;
+  }
+
+  SearchCache::Result::~Result()
+  {
+    bytes_ -= size_;
+  }
+
+  const std::string &SearchCache::Result::line(size_t index, const Render &render) const
+  {
+    const size_t page = index / pageSize_;
+    std::call_once(rendered_[page], [this, page, &render]()
+                   {
+                     const size_t begin = page * pageSize_;
+                     const size_t count = std::min(pageSize_, ids_.size() - begin);
+                     std::vector<std::string> lines = render(std::span<const uint32_t>(ids_).subspan(begin, count));
+                     lines.resize(count);
+                     for (size_t i = 0; i < count; ++i)
+                     {
+                       lines_[begin + i] = std::move(lines[i]);
+                       size_ += lines_[begin + i].capacity();
+                       bytes_ += lines_[begin + i].capacity();
+                     } });
+    return lines_[index];
+  }
+
+  SearchCache::SearchCache(size_t capacity, size_t pageSize)
+      : shardCapacity_(std::max<size_t>(1, (capacity + SHARDS - 1) / SHARDS)), pageSize_(std::max<size_t>(1, pageSize))
+  {
+  }
+
+  std::string SearchCache::normalize(std::string_view query)
+  {
+    return DictImage::normalize(query);
+  }
+
+  std::string SearchCache::makeKey(Kind kind, std::string_view query)
+  {
+    std::string key(1, static_cast<char>(kind));
+    key += normalize(query);
+    return key;
+  }
+
+  SearchCache::Shard &SearchCache::shard(const std::string &key)
+  {
+    return shards_[std::hash<std::string>()(key) % SHARDS];
+  }
+
+  SearchCache::Result::Ptr SearchCache::find(Kind kind, std::string_view query)
+  {
+    const std::string key = makeKey(kind, query);
+    Shard &target = shard(key);
+    std::lock_guard<std::mutex> lock(target.mutex);
+    auto it = target.index.find(key);
+    if (it == target.index.end())
+    {
+      misses_++;
+      return nullptr;
+    }
+    hits_++;
+    target.order.splice(target.order.begin(), target.order, it->second);
+    return it->second->second;
+  }
+
+  SearchCache::Result::Ptr SearchCache::insert(Kind kind, std::string_view query, std::vector<uint32_t> ids)
+  {
+    std::string key = makeKey(kind, query);
+    auto result = std::make_shared<const Result>(std::move(ids), pageSize_, bytes_);
+    Shard &target = shard(key);
+    std::lock_guard<std::mutex> lock(target.mutex);
+    auto it = target.index.find(key);
+    if (it != target.index.end())
+    {
+      // Another user searched for the same thing meanwhile, keep the first
+      target.order.splice(target.order.begin(), target.order, it->second);
+      return it->second->second;
+    }
+
+    target.order.emplace_front(std::move(key), result);
+    target.index.emplace(target.order.front().first, target.order.begin());
+    while (target.order.size() > shardCapacity_)
+    {
+      // Pages being shown keep their result alive until the user is done
+      target.index.erase(target.order.back().first);
+      target.order.pop_back();
+      evictions_++;
+    }
+    return result;
+  }
+
+  SearchCache::Stats SearchCache::stats() const
+  {
+    Stats result;
+    for (const Shard &shard : shards_)
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      result.entries += shard.order.size();
+    }
+    result.bytes = bytes_;
+    result.hits = hits_;
+    result.misses = misses_;
+    result.evictions = evictions_;
+    return result;
+  }
+}
\ No newline at end of file
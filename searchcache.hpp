@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Bot
+{
+  // Sharded LRU cache of dictionary search results keyed by the kind of
+  // search and the normalized query. A result holds the ranked IDs and the
+  // lines rendered for them so far; lines are rendered a page at a time, the
+  // first time any user reaches that page, and shared from then on.
+  class SearchCache
+  {
+  public:
+    using Ptr = std::unique_ptr<SearchCache>;
+    // Renders one line per ID of a page
+    using Render = std::function<std::vector<std::string>(std::span<const uint32_t> ids)>;
+
+    enum class Kind : uint8_t
+    {
+      word,
+      example,
+      wordInfo,
+      // Inline-mode suggestions, IDs are SuggestionIndex positions
+      suggestion,
+      // Fuzzy corrections, looked up as typed without deinflection
+      correction,
+    };
+
+    class Result
+    {
+    public:
+      using Ptr = std::shared_ptr<const Result>;
+
+      Result(std::vector<uint32_t> ids, size_t pageSize, std::atomic<size_t> &bytes);
+      ~Result();
+      Result(const Result &) = delete;
+      Result &operator=(const Result &) = delete;
+
+      const std::vector<uint32_t> &ids() const { return ids_; }
+      // Renders the page holding index if needed. Throws what render throws,
+      // the page is retried on the next call.
+      const std::string &line(size_t index, const Render &render) const;
+
+    private:
+      const std::vector<uint32_t> ids_;
+      const size_t pageSize_;
+      mutable std::vector<std::string> lines_;
+      const std::unique_ptr<std::once_flag[]> rendered_;
+      mutable std::atomic<size_t> size_;
+      std::atomic<size_t> &bytes_;
+    };
+
+    struct Stats
+    {
+      size_t entries = 0;
+      size_t bytes = 0;
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0;
+    };
+
+    SearchCache(size_t capacity, size_t pageSize);
+    SearchCache(const SearchCache &) = delete;
+    SearchCache &operator=(const SearchCache &) = delete;
+
+    Result::Ptr find(Kind kind, std::string_view query);
+    Result::Ptr insert(Kind kind, std::string_view query, std::vector<uint32_t> ids);
+    Stats stats() const;
+
+    // Lowercases ASCII and collapses runs of whitespace
+    static std::string normalize(std::string_view query);
+
+  private:
+    static constexpr size_t SHARDS = 16;
+
+    struct Shard
+    {
+      using Entry = std::pair<std::string, Result::Ptr>;
+
+      mutable std::mutex mutex;
+      // Most recently used first
+      std::list<Entry> order;
+      std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    };
+
+    static std::string makeKey(Kind kind, std::string_view query);
+    Shard &shard(const std::string &key);
+
+    const size_t shardCapacity_;
+    const size_t pageSize_;
+    std::array<Shard, SHARDS> shards_;
+    std::atomic<size_t> bytes_ = 0;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> evictions_ = 0;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,338 @@
+#include "sendscheduler.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  constexpr std::chrono::seconds IDLE_SWEEP_PERIOD(1);
+
+  // Telegram answers flood control with "Too Many Requests: retry after N"
+  std::chrono::seconds retryAfter(const char *description)
+  {
+    constexpr std::string_view marker = "retry after ";
+    const std::string_view text(description);
+    if (!text.starts_with("Too Many Requests"))
+    {
+      return std::chrono::seconds(0);
+    }
+    const size_t pos = text.find(marker);
+    if (pos == std::string_view::npos)
+    {
+      return std::chrono::seconds(1);
+    }
+    const long seconds = std::strtol(description + pos + marker.size(), nullptr, 10);
+    return std::chrono::seconds(std::max(1L, seconds));
+  }
+}
+
+namespace Bot
+{
+  void SendScheduler::TokenBucket::refill(Clock::time_point now)
+  {
+    const double elapsed = std::chrono::duration<double>(now - updated).count();
+    tokens = std::min(burst, tokens + elapsed * rate);
+    updated = now;
+  }
+
+  SendScheduler::Clock::duration SendScheduler::TokenBucket::wait() const
+  {
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1.0 - tokens) / rate));
+  }
+
+  SendScheduler::Job SendScheduler::Job::call(Call run, std::function<void(std::exception_ptr)> fail)
+  {
+    Job job;
+    job.run = std::move(run);
+    job.fail = std::move(fail);
+    return job;
+  }
+
+  SendScheduler::SendScheduler(TgBot::Bot &bot, const SendConfig &config)
+      : bot_(bot), config_(config), linger_(std::chrono::milliseconds(config.lingerMs))
+  {
+    global_.rate = global_.burst = global_.tokens = std::max<size_t>(1, config_.globalRate);
+    global_.updated = Clock::now();
+    lastSweep_ = global_.updated;
+
+    const size_t senders = std::max<size_t>(1, config_.senders);
+    for (size_t i = 0; i < senders; ++i)
+    {
+      threads_.emplace_back(&SendScheduler::run, this);
+    }
+    LOG_INFO("Send scheduler started: {} senders, {} req/s global, {} req/s per chat\n", senders, global_.rate, config_.chatRate);
+  }
+
+  SendScheduler::~SendScheduler()
+  {
+    stop();
+  }
+
+  void SendScheduler::stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto &thread : threads_)
+    {
+      if (thread.joinable())
+      {
+        thread.join();
+      }
+    }
+  }
+
+  void SendScheduler::sendMessage(int64_t chatID, std::string text, TgBot::GenericReply::Ptr replyMarkup, std::string parseMode)
+  {
+    Job job;
+    job.text = true;
+    job.message = std::move(text);
+    job.replyMarkup = std::move(replyMarkup);
+    job.parseMode = std::move(parseMode);
+    texts_++;
+    enqueue(chatID, std::move(job));
+  }
+
+  void SendScheduler::post(int64_t chatID, Call call)
+  {
+    enqueue(chatID, Job::call(std::move(call), nullptr));
+  }
+
+  void SendScheduler::enqueue(int64_t chatID, Job job)
+  {
+    job.queued = Clock::now();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto [it, created] = chats_.try_emplace(chatID);
+      Chat &chat = it->second;
+      if (created)
+      {
+        chat.bucket.rate = std::max<size_t>(1, config_.chatRate);
+        chat.bucket.burst = chat.bucket.tokens = std::max<size_t>(1, config_.chatBurst);
+        chat.bucket.updated = job.queued;
+      }
+      if (chat.jobs.empty() && !chat.inFlight)
+      {
+        order_.push_back(chatID);
+      }
+      chat.jobs.push_back(std::move(job));
+      queued_++;
+    }
+    cv_.notify_one();
+  }
+
+  void SendScheduler::coalesce(Chat &chat, Job &job)
+  {
+    // A message that carries a keyboard must stay last, nothing is appended to it
+    while (job.text && !job.replyMarkup && !chat.jobs.empty())
+    {
+      Job &next = chat.jobs.front();
+      if (!next.text || next.parseMode != job.parseMode || job.message.size() + 1 + next.message.size() > MAX_MESSAGE_SIZE)
+      {
+        break;
+      }
+      job.message += '\n';
+      job.message += next.message;
+      job.replyMarkup = std::move(next.replyMarkup);
+      chat.jobs.pop_front();
+      queued_--;
+      coalesced_++;
+    }
+  }
+
+  bool SendScheduler::take(int64_t &chatID, Job &job, Clock::time_point &wakeAt)
+  {
+    const auto now = Clock::now();
+    if (now - lastSweep_ >= IDLE_SWEEP_PERIOD)
+    {
+      // Idle chats are kept until their bucket is full again, otherwise
+      // a chat could exceed its rate by going quiet for a moment.
+      for (auto it = chats_.begin(); it != chats_.end();)
+      {
+        Chat &chat = it->second;
+        chat.bucket.refill(now);
+        if (chat.jobs.empty() && !chat.inFlight && chat.bucket.tokens >= chat.bucket.burst)
+        {
+          it = chats_.erase(it);
+          continue;
+        }
+        ++it;
+      }
+      lastSweep_ = now;
+    }
+
+    global_.refill(now);
+    for (size_t i = 0; i < order_.size(); ++i)
+    {
+      Chat &chat = chats_[order_[i]];
+      if (now < chat.notBefore)
+      {
+        wakeAt = std::min(wakeAt, chat.notBefore);
+        continue;
+      }
+
+      const Job &front = chat.jobs.front();
+      if (front.text && chat.jobs.size() == 1 && !stopping_ && now - front.queued < linger_)
+      {
+        wakeAt = std::min(wakeAt, front.queued + linger_);
+        continue;
+      }
+
+      chat.bucket.refill(now);
+      if (chat.bucket.tokens < 1)
+      {
+        wakeAt = std::min(wakeAt, now + chat.bucket.wait());
+        continue;
+      }
+      if (global_.tokens < 1)
+      {
+        wakeAt = std::min(wakeAt, now + global_.wait());
+        return false;
+      }
+
+      chat.bucket.tokens -= 1;
+      global_.tokens -= 1;
+      job = std::move(chat.jobs.front());
+      chat.jobs.pop_front();
+      queued_--;
+      coalesce(chat, job);
+      chat.inFlight = true;
+      chatID = order_[i];
+      // Requeued by finish() if the chat still has work, behind everyone else
+      order_.erase(order_.begin() + i);
+      return true;
+    }
+    return false;
+  }
+
+  void SendScheduler::perform(int64_t chatID, Job &job)
+  {
+    const uint64_t delayUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - job.queued).count();
+    totalDelayUs_ += delayUs;
+    uint64_t currentMax = maxDelayUs_;
+    while (delayUs > currentMax && !maxDelayUs_.compare_exchange_weak(currentMax, delayUs))
+    {
+    }
+
+    requests_++;
+    try
+    {
+      if (job.text)
+      {
+        bot_.getApi().sendMessage(chatID, job.message, false, 0, job.replyMarkup ? job.replyMarkup : std::make_shared<TgBot::GenericReply>(), job.parseMode);
+      }
+      else
+      {
+        job.run();
+      }
+    }
+    catch (const TgBot::TgException &e)
+    {
+      const auto delay = retryAfter(e.what());
+      if (delay.count() && ++job.attempts < config_.maxAttempts)
+      {
+        rateLimited_++;
+        LOG_DEBUG("Chat {} is rate limited, retrying in {}s\n", chatID, delay.count());
+        finish(chatID, job, delay);
+        return;
+      }
+      failed_++;
+      if (job.fail)
+      {
+        job.fail(std::current_exception());
+      }
+      else
+      {
+        LOG_DEBUG("Request to chat {} dropped\n", chatID);
+        LOG_EXCEPTION("Send scheduler exception", e);
+      }
+    }
+    catch (const std::exception &e)
+    {
+      failed_++;
+      if (job.fail)
+      {
+        job.fail(std::current_exception());
+      }
+      else
+      {
+        LOG_DEBUG("Request to chat {} dropped\n", chatID);
+        LOG_EXCEPTION("Send scheduler exception", e);
+      }
+    }
+    finish(chatID, job, std::chrono::seconds(0));
+  }
+
+  void SendScheduler::finish(int64_t chatID, Job &job, std::chrono::seconds delay)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Chat &chat = chats_[chatID];
+      chat.inFlight = false;
+      if (delay.count())
+      {
+        chat.notBefore = Clock::now() + delay;
+        chat.jobs.push_front(std::move(job));
+        queued_++;
+      }
+      if (!chat.jobs.empty())
+      {
+        order_.push_back(chatID);
+      }
+    }
+    cv_.notify_one();
+  }
+
+  void SendScheduler::run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      int64_t chatID = 0;
+      Job job;
+      auto wakeAt = Clock::time_point::max();
+      if (take(chatID, job, wakeAt))
+      {
+        lock.unlock();
+        perform(chatID, job);
+        lock.lock();
+        continue;
+      }
+
+      if (stopping_ && !queued_)
+      {
+        return;
+      }
+      if (wakeAt == Clock::time_point::max())
+      {
+        cv_.wait(lock);
+      }
+      else
+      {
+        cv_.wait_until(lock, wakeAt);
+      }
+    }
+  }
+
+  SendScheduler::Stats SendScheduler::stats() const
+  {
+    Stats result;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      result.queued = queued_;
+    }
+    result.texts = texts_;
+    result.requests = requests_;
+    result.coalesced = coalesced_;
+    result.rateLimited = rateLimited_;
+    result.failed = failed_;
+    result.maxDelayUs = maxDelayUs_;
+    if (result.requests)
+    {
+      result.avgDelayUs = totalDelayUs_ / result.requests;
+    }
+    return result;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <tgbot/tgbot.h>
+#include "botconfig.hpp"
+
+namespace Bot
+{
+  // Outbound request scheduler. Every Bot API call addressed to a chat goes
+  // through here, in order per chat. Consecutive plain texts for one chat are
+  // merged into one message while they fit, requests are paced by a global
+  // and a per-chat token bucket, and "Too Many Requests" is retried after the
+  // delay Telegram asks for.
+  class SendScheduler
+  {
+  public:
+    using Ptr = std::unique_ptr<SendScheduler>;
+    using Call = std::function<void()>;
+
+    // Telegram's limit on the text of one message
+    static constexpr size_t MAX_MESSAGE_SIZE = 4096;
+
+    struct Stats
+    {
+      size_t queued = 0;
+      uint64_t texts = 0;
+      uint64_t requests = 0;
+      uint64_t coalesced = 0;
+      uint64_t rateLimited = 0;
+      uint64_t failed = 0;
+      uint64_t avgDelayUs = 0;
+      uint64_t maxDelayUs = 0;
+    };
+
+    SendScheduler(TgBot::Bot &bot, const SendConfig &config = SendConfig());
+    ~SendScheduler();
+    SendScheduler(const SendScheduler &) = delete;
+    SendScheduler &operator=(const SendScheduler &) = delete;
+
+    void sendMessage(int64_t chatID,
+                     std::string text,
+                     TgBot::GenericReply::Ptr replyMarkup = nullptr,
+                     std::string parseMode = "");
+
+    // Runs an arbitrary API call in the chat's order. Texts queued before it
+    // are sent first.
+    void post(int64_t chatID, Call call);
+
+    // Same as post() for calls whose result the caller needs.
+    template <typename F>
+    auto call(int64_t chatID, F fn) -> std::future<std::invoke_result_t<F>>
+    {
+      using Result = std::invoke_result_t<F>;
+      auto promise = std::make_shared<std::promise<Result>>();
+      auto future = promise->get_future();
+      enqueue(chatID, Job::call(
+                          [promise, fn = std::move(fn)]() mutable
+                          {
+                            if constexpr (std::is_void_v<Result>)
+                            {
+                              fn();
+                              promise->set_value();
+                            }
+                            else
+                            {
+                              promise->set_value(fn());
+                            }
+                          },
+                          [promise](std::exception_ptr error)
+                          { promise->set_exception(error); }));
+      return future;
+    }
+
+    // Sends what is queued and returns once the threads are done. Requests
+    // queued afterwards are kept but never sent.
+    void stop();
+
+    Stats stats() const;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct TokenBucket
+    {
+      double tokens = 0;
+      double rate = 1;
+      double burst = 1;
+      Clock::time_point updated;
+
+      void refill(Clock::time_point now);
+      Clock::duration wait() const;
+    };
+
+    struct Job
+    {
+      // Text jobs are mergeable, call jobs are not
+      bool text = false;
+      std::string message;
+      std::string parseMode;
+      TgBot::GenericReply::Ptr replyMarkup;
+      Call run;
+      std::function<void(std::exception_ptr)> fail;
+      size_t attempts = 0;
+      Clock::time_point queued;
+
+      static Job call(Call run, std::function<void(std::exception_ptr)> fail);
+    };
+
+    struct Chat
+    {
+      std::deque<Job> jobs;
+      TokenBucket bucket;
+      Clock::time_point notBefore;
+      bool inFlight = false;
+    };
+
+    void enqueue(int64_t chatID, Job job);
+    void run();
+    bool take(int64_t &chatID, Job &job, Clock::time_point &wakeAt);
+    void coalesce(Chat &chat, Job &job);
+    void perform(int64_t chatID, Job &job);
+    void finish(int64_t chatID, Job &job, std::chrono::seconds delay);
+
+    TgBot::Bot &bot_;
+    const SendConfig config_;
+    const Clock::duration linger_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<int64_t, Chat> chats_;
+    // Chats with queued work that are not in flight, served round-robin
+    std::deque<int64_t> order_;
+    Clock::time_point lastSweep_;
+    TokenBucket global_;
+    size_t queued_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+
+    std::atomic<uint64_t> texts_ = 0;
+    std::atomic<uint64_t> requests_ = 0;
+    std::atomic<uint64_t> coalesced_ = 0;
+    std::atomic<uint64_t> rateLimited_ = 0;
+    std::atomic<uint64_t> failed_ = 0;
+    std::atomic<uint64_t> totalDelayUs_ = 0;
+    std::atomic<uint64_t> maxDelayUs_ = 0;
+  };
+}
\ No newline at end of file
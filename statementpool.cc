@@ -0,0 +1,74 @@
+#include "statementpool.hpp"
+#include "log.hpp"
+
+namespace Bot
+{
+  StatementPool::Lease::Lease(StatementPool &pool, std::string_view sql, std::unique_ptr<SQLite::Statement> statement)
+      : pool_(pool), sql_(sql), statement_(std::move(statement))
+  {
+  }
+
+  StatementPool::Lease::~Lease()
+  {
+    if (statement_)
+    {
+      pool_.release(sql_, std::move(statement_));
+    }
+  }
+
+  StatementPool::StatementPool(SQLite::Database &db)
+      : db_(db)
+  {
+  }
+
+  StatementPool::Lease StatementPool::acquire(std::string_view sql)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = idle_.find(sql);
+      if (it != idle_.end() && !it->second.empty())
+      {
+        std::unique_ptr<SQLite::Statement> statement = std::move(it->second.back());
+        it->second.pop_back();
+        reused_++;
+        return Lease(*this, sql, std::move(statement));
+      }
+    }
+
+    prepared_++;
+    return Lease(*this, sql, std::make_unique<SQLite::Statement>(db_, std::string(sql)));
+  }
+
+  void StatementPool::release(std::string_view sql, std::unique_ptr<SQLite::Statement> statement)
+  {
+    try
+    {
+      // reset() reports the error of the last step, the statement is usable either way
+      statement->reset();
+    }
+    catch (const SQLite::Exception &)
+    {
+    }
+
+    try
+    {
+      statement->clearBindings();
+    }
+    catch (const SQLite::Exception &e)
+    {
+      LOG_EXCEPTION("Dropping a prepared statement", e);
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_[sql].push_back(std::move(statement));
+  }
+
+  StatementPool::Stats StatementPool::stats() const
+  {
+    Stats result;
+    result.prepared = prepared_;
+    result.reused = reused_;
+    return result;
+  }
+}
\ No newline at end of file
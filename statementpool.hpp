@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <SQLiteCpp/SQLiteCpp.h>
+
+namespace Bot
+{
+  // Prepared statements of one connection, kept for reuse instead of being
+  // parsed on every call. A statement is leased to one thread at a time and
+  // returned reset with its bindings cleared, so callers on different threads
+  // never share statement state. The pool must be destroyed before the
+  // database it prepares statements for.
+  class StatementPool
+  {
+  public:
+    using Ptr = std::unique_ptr<StatementPool>;
+
+    class Lease
+    {
+    public:
+      Lease(StatementPool &pool, std::string_view sql, std::unique_ptr<SQLite::Statement> statement);
+      ~Lease();
+      Lease(Lease &&) = default;
+      Lease(const Lease &) = delete;
+      Lease &operator=(const Lease &) = delete;
+
+      SQLite::Statement &operator*() { return *statement_; }
+      SQLite::Statement *operator->() { return statement_.get(); }
+
+    private:
+      StatementPool &pool_;
+      std::string_view sql_;
+      std::unique_ptr<SQLite::Statement> statement_;
+    };
+
+    struct Stats
+    {
+      uint64_t prepared = 0;
+      uint64_t reused = 0;
+    };
+
+    StatementPool(SQLite::Database &db);
+    StatementPool(const StatementPool &) = delete;
+    StatementPool &operator=(const StatementPool &) = delete;
+
+    // `sql` must outlive the pool, in practice it is a string literal.
+    Lease acquire(std::string_view sql);
+    Stats stats() const;
+
+  private:
+    void release(std::string_view sql, std::unique_ptr<SQLite::Statement> statement);
+
+    SQLite::Database &db_;
+    std::mutex mutex_;
+    std::unordered_map<std::string_view, std::vector<std::unique_ptr<SQLite::Statement>>> idle_;
+    std::atomic<uint64_t> prepared_ = 0;
+    std::atomic<uint64_t> reused_ = 0;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "suggestionindex.hpp"
+#include "levenshtein.hpp"
+
+#include <algorithm>
+
+namespace Bot
+{
+  SuggestionIndex::Builder::Ref SuggestionIndex::Builder::intern(std::string_view text)
+  {
+    Ref ref{static_cast<uint32_t>(arena_.size()), static_cast<uint32_t>(text.size())};
+    arena_ += text;
+    return ref;
+  }
+
+  uint32_t SuggestionIndex::Builder::add(std::string_view title, std::string_view reading, std::string_view gloss)
+  {
+    suggestions_.push_back({intern(title), intern(reading), intern(gloss)});
+    return static_cast<uint32_t>(suggestions_.size() - 1);
+  }
+
+  void SuggestionIndex::Builder::key(uint32_t suggestion, std::string_view key)
+  {
+    if (!key.empty())
+    {
+      keys_.emplace_back(intern(key), suggestion);
+    }
+  }
+
+  SuggestionIndex::Ptr SuggestionIndex::Builder::build()
+  {
+    std::unique_ptr<SuggestionIndex> index(new SuggestionIndex());
+    index->arena_ = std::move(arena_);
+    index->arena_.shrink_to_fit();
+    const std::string &arena = index->arena_;
+    auto view = [&arena](const Ref &ref)
+    { return std::string_view(arena.data() + ref.offset, ref.length); };
+
+    index->suggestions_.reserve(suggestions_.size());
+    for (const auto &[title, reading, gloss] : suggestions_)
+    {
+      index->suggestions_.push_back({view(title), view(reading), view(gloss)});
+    }
+
+    // Shorter titles first within a key, they are usually the more common words
+    std::sort(keys_.begin(), keys_.end(), [&](const auto &lhs, const auto &rhs)
+              {
+      const std::string_view left = view(lhs.first);
+      const std::string_view right = view(rhs.first);
+      if (left != right)
+      {
+        return left < right;
+      }
+      const size_t leftTitle = index->suggestions_[lhs.second].title.size();
+      const size_t rightTitle = index->suggestions_[rhs.second].title.size();
+      return leftTitle != rightTitle ? leftTitle < rightTitle : lhs.second < rhs.second; });
+
+    index->postings_.reserve(keys_.size());
+    for (const auto &[ref, suggestion] : keys_)
+    {
+      const std::string_view key = view(ref);
+      if (index->keys_.empty() || index->keys_.back().key != key)
+      {
+        index->keys_.push_back({key, static_cast<uint32_t>(index->postings_.size())});
+      }
+      // The same word may be reachable from a key twice, e.g. reading and romaji of a kana word
+      if (index->postings_.size() == index->keys_.back().postingBegin || index->postings_.back() != suggestion)
+      {
+        index->postings_.push_back(suggestion);
+      }
+    }
+    index->keys_.shrink_to_fit();
+    keys_.clear();
+    suggestions_.clear();
+    return index;
+  }
+
+  std::vector<uint32_t> SuggestionIndex::find(std::string_view prefix, size_t limit) const
+  {
+    std::vector<uint32_t> result;
+    if (prefix.empty())
+    {
+      return result;
+    }
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), prefix, [](const Key &key, std::string_view prefix)
+                               { return key.key < prefix; });
+    for (; it != keys_.end() && it->key.starts_with(prefix) && result.size() < limit; ++it)
+    {
+      const size_t end = it + 1 == keys_.end() ? postings_.size() : (it + 1)->postingBegin;
+      for (size_t i = it->postingBegin; i < end && result.size() < limit; ++i)
+      {
+        // Limits are small, a linear check beats a set
+        if (std::find(result.begin(), result.end(), postings_[i]) == result.end())
+        {
+          result.push_back(postings_[i]);
+        }
+      }
+    }
+    return result;
+  }
+
+  std::vector<SuggestionIndex::FuzzyMatch> SuggestionIndex::fuzzy(std::string_view query, unsigned maxEdits, size_t limit) const
+  {
+    std::vector<FuzzyMatch> result;
+    if (query.empty())
+    {
+      return result;
+    }
+    const LevenshteinAutomaton automaton(query, maxEdits);
+    const size_t width = automaton.stateSize();
+    const size_t maxDepth = automaton.maxLength() + 1;
+    // states[d] is the state after d code points of the last key, which
+    // ended at byte ends[d]; the first valid + 1 of them are current
+    std::vector<uint8_t> states(width * (maxDepth + 1));
+    std::vector<size_t> ends(maxDepth + 1);
+    auto state = [&states, width](size_t depth)
+    { return LevenshteinAutomaton::State(states.data() + depth * width, width); };
+    automaton.start(state(0));
+    size_t valid = 0;
+    std::string_view last;
+
+    for (auto it = keys_.begin(); it != keys_.end();)
+    {
+      const std::string_view key = it->key;
+      const size_t shared = std::mismatch(key.begin(), key.begin() + std::min(key.size(), last.size()), last.begin()).first - key.begin();
+      size_t depth = 0;
+      while (depth < valid && ends[depth + 1] <= shared)
+      {
+        depth++;
+      }
+      last = key;
+
+      bool alive = true;
+      for (size_t pos = ends[depth]; pos < key.size();)
+      {
+        const char32_t c = nextCodePoint(key, pos);
+        if (depth + 1 > maxDepth || !automaton.step(state(depth), c, state(depth + 1)))
+        {
+          alive = false;
+          break;
+        }
+        ends[++depth] = pos;
+      }
+      valid = depth;
+      if (alive)
+      {
+        if (automaton.matches(state(depth)))
+        {
+          result.push_back({key, automaton.distance(state(depth))});
+        }
+        ++it;
+        continue;
+      }
+      // Nothing that starts like this key up to the dead code point can match
+      size_t deadEnd = ends[depth];
+      nextCodePoint(key, deadEnd);
+      const std::string_view dead = key.substr(0, deadEnd);
+      it = std::partition_point(it, keys_.end(), [dead](const Key &other)
+                                { return other.key.starts_with(dead); });
+    }
+
+    std::sort(result.begin(), result.end(), [](const FuzzyMatch &lhs, const FuzzyMatch &rhs)
+              { return lhs.distance != rhs.distance ? lhs.distance < rhs.distance : lhs.key < rhs.key; });
+    if (result.size() > limit)
+    {
+      result.resize(limit);
+    }
+    return result;
+  }
+
+  size_t SuggestionIndex::memoryUsage() const
+  {
+    return arena_.capacity() + suggestions_.capacity() * sizeof(Suggestion) + keys_.capacity() * sizeof(Key) +
+           postings_.capacity() * sizeof(uint32_t);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Bot
+{
+  // Prefix index for inline-mode autocomplete. Suggestions are keyed by their
+  // writings, kana readings, romaji and gloss words; keys live in one sorted
+  // table over a shared arena, so a keystroke costs a binary search plus a
+  // walk over the keys that start with the prefix. Immutable once built.
+  class SuggestionIndex
+  {
+  public:
+    using Ptr = std::unique_ptr<const SuggestionIndex>;
+
+    struct Suggestion
+    {
+      std::string_view title;
+      std::string_view reading;
+      std::string_view gloss;
+    };
+
+    struct FuzzyMatch
+    {
+      std::string_view key;
+      unsigned distance;
+    };
+
+    class Builder
+    {
+    public:
+      // Returns the suggestion's position, keys are attached with key()
+      uint32_t add(std::string_view title, std::string_view reading, std::string_view gloss);
+      // Gloss keys should be normalized like queries are
+      void key(uint32_t suggestion, std::string_view key);
+      Ptr build();
+
+    private:
+      struct Ref
+      {
+        uint32_t offset;
+        uint32_t length;
+      };
+
+      Ref intern(std::string_view text);
+
+      std::string arena_;
+      std::vector<std::array<Ref, 3>> suggestions_;
+      std::vector<std::pair<Ref, uint32_t>> keys_;
+    };
+
+    size_t size() const { return suggestions_.size(); }
+    size_t keys() const { return keys_.size(); }
+    size_t memoryUsage() const;
+    Suggestion suggestion(uint32_t index) const { return suggestions_[index]; }
+
+    // Up to limit distinct suggestions with a key starting with prefix, exact keys first
+    std::vector<uint32_t> find(std::string_view prefix, size_t limit) const;
+    // Up to limit keys within maxEdits edits of query, closest first. The
+    // key table is walked with a Levenshtein automaton, a key resumes from
+    // the prefix it shares with the one before and a prefix that can't
+    // match any more is skipped with a binary search.
+    std::vector<FuzzyMatch> fuzzy(std::string_view query, unsigned maxEdits, size_t limit) const;
+
+  private:
+    struct Key
+    {
+      std::string_view key;
+      uint32_t postingBegin;
+    };
+
+    SuggestionIndex() = default;
+
+    std::string arena_;
+    std::vector<Suggestion> suggestions_;
+    // Sorted unique keys, each followed in postings_ by the suggestions it leads to
+    std::vector<Key> keys_;
+    std::vector<uint32_t> postings_;
+  };
+}
\ No newline at end of file
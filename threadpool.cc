@@ -0,0 +1,184 @@
+#include "threadpool.hpp"
+#include "log.hpp"
+
+namespace
+{
+  thread_local const Bot::ThreadPool *currentPool = nullptr;
+  thread_local size_t currentWorker = 0;
+
+  void updateMax(std::atomic<uint64_t> &target, uint64_t value)
+  {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+  }
+}
+
+namespace Bot
+{
+  ThreadPool::ThreadPool(size_t workers, size_t capacity)
+      : capacity_(capacity ? capacity : 1)
+  {
+    if (!workers)
+    {
+      workers = std::max(2u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < workers; ++i)
+    {
+      queues_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers; ++i)
+    {
+      threads_.emplace_back(&ThreadPool::run, this, i);
+    }
+    LOG_INFO("Thread pool started: {} workers, queue capacity {}\n", workers, capacity_);
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex_);
+      stopping_ = true;
+    }
+    wakeCv_.notify_all();
+    spaceCv_.notify_all();
+    for (auto &thread : threads_)
+    {
+      thread.join();
+    }
+  }
+
+  void ThreadPool::submit(Task task)
+  {
+    const bool fromWorker = currentPool == this;
+    size_t depth = 0;
+    {
+      std::unique_lock<std::mutex> lock(wakeMutex_);
+      if (!fromWorker && pending_ >= capacity_)
+      {
+        throttled_++;
+        spaceCv_.wait(lock, [this]
+                      { return pending_ < capacity_ || stopping_; });
+      }
+      depth = ++pending_;
+    }
+
+    const size_t index = fromWorker ? currentWorker : nextQueue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    {
+      std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+      queues_[index]->queue.push_back({std::move(task), Clock::now()});
+    }
+
+    updateMax(maxQueueDepth_, depth);
+    wakeCv_.notify_one();
+  }
+
+  bool ThreadPool::pop(size_t index, Item &item)
+  {
+    {
+      std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+      if (!queues_[index]->queue.empty())
+      {
+        item = std::move(queues_[index]->queue.front());
+        queues_[index]->queue.pop_front();
+        return true;
+      }
+    }
+
+    for (size_t i = 1; i < queues_.size(); ++i)
+    {
+      Worker &victim = *queues_[(index + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.queue.empty())
+      {
+        item = std::move(victim.queue.back());
+        victim.queue.pop_back();
+        stolen_++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void ThreadPool::execute(Item &item)
+  {
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex_);
+      --pending_;
+    }
+    spaceCv_.notify_one();
+
+    const auto started = Clock::now();
+    const uint64_t waitUs = std::chrono::duration_cast<std::chrono::microseconds>(started - item.queued).count();
+    try
+    {
+      item.task();
+    }
+    catch (const std::exception &e)
+    {
+      LOG_EXCEPTION("Unhandled exception in worker task", e);
+    }
+    catch (...)
+    {
+      LOG_INFO("Unknown exception in worker task\n");
+    }
+    const uint64_t runUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count();
+
+    completed_++;
+    totalWaitUs_ += waitUs;
+    totalRunUs_ += runUs;
+    updateMax(maxWaitUs_, waitUs);
+    updateMax(maxRunUs_, runUs);
+  }
+
+  void ThreadPool::run(size_t index)
+  {
+    currentPool = this;
+    currentWorker = index;
+    while (true)
+    {
+      Item item;
+      if (pop(index, item))
+      {
+        execute(item);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(wakeMutex_);
+      if (stopping_ && !pending_)
+      {
+        return;
+      }
+      wakeCv_.wait(lock, [this]
+                   { return stopping_ || pending_; });
+      if (stopping_ && !pending_)
+      {
+        return;
+      }
+    }
+  }
+
+  ThreadPool::Stats ThreadPool::stats() const
+  {
+    Stats result;
+    result.workers = threads_.size();
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex_);
+      result.queueDepth = pending_;
+    }
+    result.maxQueueDepth = maxQueueDepth_;
+    result.completed = completed_;
+    result.stolen = stolen_;
+    result.throttled = throttled_;
+    result.maxWaitUs = maxWaitUs_;
+    result.maxRunUs = maxRunUs_;
+    if (result.completed)
+    {
+      result.avgWaitUs = totalWaitUs_ / result.completed;
+      result.avgRunUs = totalRunUs_ / result.completed;
+    }
+    return result;
+  }
+}
\ No newline at end of file
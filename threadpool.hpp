@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Bot
+{
+  // Fixed-size work-stealing executor. Every worker owns a queue, idle workers
+  // steal from their neighbours. The total number of queued tasks is bounded:
+  // submit() blocks the producer once the limit is reached, except when it is
+  // called from a worker, which would otherwise deadlock the pool.
+  class ThreadPool
+  {
+  public:
+    using Ptr = std::unique_ptr<ThreadPool>;
+    using Task = std::function<void()>;
+
+    struct Stats
+    {
+      size_t workers = 0;
+      size_t queueDepth = 0;
+      size_t maxQueueDepth = 0;
+      uint64_t completed = 0;
+      uint64_t stolen = 0;
+      uint64_t throttled = 0;
+      uint64_t avgWaitUs = 0;
+      uint64_t maxWaitUs = 0;
+      uint64_t avgRunUs = 0;
+      uint64_t maxRunUs = 0;
+    };
+
+    ThreadPool(size_t workers, size_t capacity);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(Task task);
+    Stats stats() const;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Item
+    {
+      Task task;
+      Clock::time_point queued;
+    };
+
+    struct Worker
+    {
+      std::mutex mutex;
+      std::deque<Item> queue;
+    };
+
+    void run(size_t index);
+    bool pop(size_t index, Item &item);
+    void execute(Item &item);
+
+    const size_t capacity_;
+    std::vector<std::unique_ptr<Worker>> queues_;
+    std::vector<std::thread> threads_;
+
+    mutable std::mutex wakeMutex_;
+    std::condition_variable wakeCv_;
+    std::condition_variable spaceCv_;
+    size_t pending_ = 0;
+    bool stopping_ = false;
+
+    std::atomic<size_t> nextQueue_ = 0;
+    std::atomic<uint64_t> maxQueueDepth_ = 0;
+    std::atomic<uint64_t> completed_ = 0;
+    std::atomic<uint64_t> stolen_ = 0;
+    std::atomic<uint64_t> throttled_ = 0;
+    std::atomic<uint64_t> totalWaitUs_ = 0;
+    std::atomic<uint64_t> maxWaitUs_ = 0;
+    std::atomic<uint64_t> totalRunUs_ = 0;
+    std::atomic<uint64_t> maxRunUs_ = 0;
+  };
+}
\ No newline at end of file
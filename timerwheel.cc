@@ -0,0 +1,83 @@
+#include "timerwheel.hpp"
+#include "log.hpp"
+
+namespace Bot
+{
+  TimerWheel::TimerWheel(std::chrono::milliseconds tick, size_t slots)
+      : tick_(tick), slots_(slots ? slots : 1)
+  {
+    thread_ = std::thread(&TimerWheel::run, this);
+  }
+
+  TimerWheel::~TimerWheel()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  void TimerWheel::schedule(std::chrono::milliseconds delay, Callback callback)
+  {
+    const size_t ticks = std::max<size_t>(1, (delay.count() + tick_.count() - 1) / tick_.count());
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t slot = (cursor_ + ticks) % slots_.size();
+    slots_[slot].push_back({(ticks - 1) / slots_.size(), std::move(callback)});
+    pending_++;
+  }
+
+  size_t TimerWheel::pending() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+  }
+
+  void TimerWheel::run()
+  {
+    auto next = std::chrono::steady_clock::now() + tick_;
+    std::vector<Callback> expired;
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (cv_.wait_until(lock, next, [this]
+                           { return stopping_; }))
+        {
+          return;
+        }
+
+        cursor_ = (cursor_ + 1) % slots_.size();
+        auto &slot = slots_[cursor_];
+        for (size_t i = 0; i < slot.size();)
+        {
+          if (slot[i].rounds)
+          {
+            slot[i].rounds--;
+            ++i;
+            continue;
+          }
+          expired.push_back(std::move(slot[i].callback));
+          slot[i] = std::move(slot.back());
+          slot.pop_back();
+          pending_--;
+        }
+      }
+      next += tick_;
+
+      for (auto &callback : expired)
+      {
+        try
+        {
+          callback();
+        }
+        catch (const std::exception &e)
+        {
+          LOG_EXCEPTION("Timer callback exception", e);
+        }
+      }
+      expired.clear();
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Bot
+{
+  // Hashed timer wheel driven by a single thread. Callbacks run on the wheel
+  // thread and are expected to be short, typically posting to a user session.
+  class TimerWheel
+  {
+  public:
+    using Ptr = std::unique_ptr<TimerWheel>;
+    using Callback = std::function<void()>;
+
+    TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100), size_t slots = 512);
+    ~TimerWheel();
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    void schedule(std::chrono::milliseconds delay, Callback callback);
+    size_t pending() const;
+
+  private:
+    struct Timer
+    {
+      size_t rounds;
+      Callback callback;
+    };
+
+    void run();
+
+    const std::chrono::milliseconds tick_;
+    std::vector<std::vector<Timer>> slots_;
+    size_t cursor_ = 0;
+    size_t pending_ = 0;
+    bool stopping_ = false;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,281 @@
+// Compiles JMdict (JMdict_e.xml) into the binary image the bot maps at
+// startup, see dictimageformat.hpp for the layout.
+//
+//   dictcompiler JMdict_e.xml dictionary.img
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "dictimageformat.hpp"
+
+namespace
+{
+  using namespace Bot;
+
+  struct Entry
+  {
+    uint32_t id = 0;
+    std::array<std::vector<std::string>, DictImage::fieldCount> fields;
+  };
+
+  std::string decodeEntities(std::string_view text)
+  {
+    static const std::pair<std::string_view, char> ENTITIES[] = {
+        {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}};
+    std::string result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+      bool decoded = false;
+      if (text[i] == '&')
+      {
+        for (const auto &[entity, c] : ENTITIES)
+        {
+          if (text.substr(i).starts_with(entity))
+          {
+            result += c;
+            i += entity.size() - 1;
+            decoded = true;
+            break;
+          }
+        }
+      }
+      if (!decoded)
+      {
+        result += text[i];
+      }
+    }
+    return result;
+  }
+
+  // Calls handler(attributes, text) for every <tag ...>text</tag> in the range
+  template <typename Handler>
+  void forEachElement(std::string_view xml, std::string_view tag, Handler handler)
+  {
+    const std::string open = "<" + std::string(tag);
+    const std::string close = "</" + std::string(tag) + ">";
+    size_t pos = 0;
+    while ((pos = xml.find(open, pos)) != std::string_view::npos)
+    {
+      const size_t nameEnd = pos + open.size();
+      if (nameEnd >= xml.size() || (xml[nameEnd] != '>' && xml[nameEnd] != ' '))
+      {
+        pos = nameEnd;
+        continue;
+      }
+      const size_t contentBegin = xml.find('>', nameEnd);
+      const size_t contentEnd = xml.find(close, contentBegin);
+      if (contentBegin == std::string_view::npos || contentEnd == std::string_view::npos)
+      {
+        return;
+      }
+      handler(xml.substr(nameEnd, contentBegin - nameEnd), xml.substr(contentBegin + 1, contentEnd - contentBegin - 1));
+      pos = contentEnd + close.size();
+    }
+  }
+
+  std::vector<Entry> parseJmdict(std::string_view xml)
+  {
+    std::vector<Entry> entries;
+    forEachElement(xml, "entry", [&entries](std::string_view, std::string_view body)
+                   {
+      Entry entry;
+      forEachElement(body, "ent_seq", [&entry](std::string_view, std::string_view text)
+                     { entry.id = static_cast<uint32_t>(std::strtoul(std::string(text).c_str(), nullptr, 10)); });
+      forEachElement(body, "keb", [&entry](std::string_view, std::string_view text)
+                     { entry.fields[DictImage::writing].push_back(decodeEntities(text)); });
+      forEachElement(body, "reb", [&entry](std::string_view, std::string_view text)
+                     { entry.fields[DictImage::reading].push_back(decodeEntities(text)); });
+      forEachElement(body, "gloss", [&entry](std::string_view attributes, std::string_view text)
+                     {
+        // The multilingual JMdict tags every gloss, JMdict_e only has English ones
+        if (attributes.find("xml:lang") == std::string_view::npos || attributes.find("xml:lang=\"eng\"") != std::string_view::npos)
+        {
+          entry.fields[DictImage::gloss].push_back(decodeEntities(text));
+        } });
+      if (entry.id && (!entry.fields[DictImage::reading].empty() || !entry.fields[DictImage::writing].empty()))
+      {
+        entries.push_back(std::move(entry));
+      } });
+    std::sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs)
+              { return lhs.id < rhs.id; });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs)
+                              { return lhs.id == rhs.id; }),
+                  entries.end());
+    return entries;
+  }
+
+  std::vector<std::string> glossWords(std::string_view gloss)
+  {
+    std::vector<std::string> words;
+    std::string word;
+    for (const char c : DictImage::normalize(gloss) + ' ')
+    {
+      const bool letter = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || static_cast<unsigned char>(c) >= 0x80;
+      if (letter)
+      {
+        word += c;
+        continue;
+      }
+      if (word.size() > 1 && std::find(words.begin(), words.end(), word) == words.end())
+      {
+        words.push_back(word);
+      }
+      word.clear();
+    }
+    return words;
+  }
+
+  class ImageWriter
+  {
+  public:
+    DictImage::StringRef intern(const std::string &text)
+    {
+      auto [it, created] = interned_.try_emplace(text, DictImage::StringRef{static_cast<uint32_t>(strings_.size()), static_cast<uint32_t>(text.size())});
+      if (created)
+      {
+        strings_ += text;
+      }
+      return it->second;
+    }
+
+    void build(const std::vector<Entry> &entries)
+    {
+      for (uint32_t index = 0; index < entries.size(); ++index)
+      {
+        const Entry &entry = entries[index];
+        ids_.push_back(entry.id);
+        for (uint32_t field = 0; field < DictImage::fieldCount; ++field)
+        {
+          fieldBegin_.push_back(static_cast<uint32_t>(values_.size()));
+          for (const std::string &value : entry.fields[field])
+          {
+            values_.push_back(intern(value));
+          }
+        }
+        for (const std::string &value : entry.fields[DictImage::writing])
+        {
+          indices_[DictImage::writingIndex].push_back({intern(value), index});
+        }
+        for (const std::string &value : entry.fields[DictImage::reading])
+        {
+          indices_[DictImage::readingIndex].push_back({intern(value), index});
+        }
+        std::vector<std::string> words;
+        for (const std::string &value : entry.fields[DictImage::gloss])
+        {
+          indices_[DictImage::glossIndex].push_back({intern(DictImage::normalize(value)), index});
+          for (std::string &word : glossWords(value))
+          {
+            if (std::find(words.begin(), words.end(), word) == words.end())
+            {
+              words.push_back(std::move(word));
+            }
+          }
+        }
+        for (const std::string &word : words)
+        {
+          indices_[DictImage::glossWordIndex].push_back({intern(word), index});
+        }
+      }
+      fieldBegin_.push_back(static_cast<uint32_t>(values_.size()));
+
+      for (auto &index : indices_)
+      {
+        std::sort(index.begin(), index.end(), [this](const DictImage::IndexEntry &lhs, const DictImage::IndexEntry &rhs)
+                  {
+          const std::string_view left(strings_.data() + lhs.key.offset, lhs.key.length);
+          const std::string_view right(strings_.data() + rhs.key.offset, rhs.key.length);
+          return left != right ? left < right : lhs.entry < rhs.entry; });
+      }
+    }
+
+    bool write(const std::string &path) const
+    {
+      DictImage::Header header{};
+      std::memcpy(header.magic, DictImage::MAGIC, sizeof(header.magic));
+      header.version = DictImage::VERSION;
+      header.byteOrder = DictImage::BYTE_ORDER_MARK;
+      header.entries = static_cast<uint32_t>(ids_.size());
+
+      std::string body;
+      auto append = [&](DictImage::Section section, const void *data, size_t size)
+      {
+        body.resize((sizeof(header) + body.size() + 7) / 8 * 8 - sizeof(header), '\0');
+        header.sections[section] = {sizeof(header) + body.size(), size};
+        body.append(static_cast<const char *>(data), size);
+      };
+      append(DictImage::strings, strings_.data(), strings_.size());
+      append(DictImage::entryIDs, ids_.data(), ids_.size() * sizeof(uint32_t));
+      append(DictImage::fieldBegin, fieldBegin_.data(), fieldBegin_.size() * sizeof(uint32_t));
+      append(DictImage::values, values_.data(), values_.size() * sizeof(DictImage::StringRef));
+      for (uint32_t section = DictImage::writingIndex; section < DictImage::sectionCount; ++section)
+      {
+        append(static_cast<DictImage::Section>(section), indices_[section].data(), indices_[section].size() * sizeof(DictImage::IndexEntry));
+      }
+      header.fileSize = sizeof(header) + body.size();
+
+      // Written next to the target and renamed, running bots keep their mapping of the old one
+      const std::string temporary = path + ".tmp";
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      out.write(body.data(), body.size());
+      out.close();
+      return out && std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    size_t strings() const { return strings_.size(); }
+    size_t indexed(DictImage::Section section) const { return indices_[section].size(); }
+
+  private:
+    std::string strings_;
+    std::unordered_map<std::string, DictImage::StringRef> interned_;
+    std::vector<uint32_t> ids_;
+    std::vector<uint32_t> fieldBegin_;
+    std::vector<DictImage::StringRef> values_;
+    std::array<std::vector<DictImage::IndexEntry>, DictImage::sectionCount> indices_;
+  };
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 3)
+  {
+    std::fprintf(stderr, "usage: %s JMdict_e.xml dictionary.img\n", argv[0]);
+    return 1;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in)
+  {
+    std::fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 1;
+  }
+  std::stringstream xml;
+  xml << in.rdbuf();
+
+  const std::vector<Entry> entries = parseJmdict(xml.str());
+  if (entries.empty())
+  {
+    std::fprintf(stderr, "no entries found in %s\n", argv[1]);
+    return 1;
+  }
+
+  ImageWriter writer;
+  writer.build(entries);
+  if (!writer.write(argv[2]))
+  {
+    std::fprintf(stderr, "cannot write %s\n", argv[2]);
+    return 1;
+  }
+  std::printf("%zu entries, %zu bytes of strings, %zu writings, %zu readings, %zu glosses, %zu gloss words\n",
+              entries.size(), writer.strings(), writer.indexed(DictImage::writingIndex), writer.indexed(DictImage::readingIndex),
+              writer.indexed(DictImage::glossIndex), writer.indexed(DictImage::glossWordIndex));
+  return 0;
+}
\ No newline at end of file
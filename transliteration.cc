@@ -0,0 +1,428 @@
+#include "transliteration.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  enum Kind : uint8_t
+  {
+    other, // not kana, copied through
+    plain,
+    smallVowel, // ぁぃぅぇぉゎ, fuse with the kana before them
+    smallY,     // ゃゅょ
+    sokuon,     // っ, doubles the next consonant
+    longMark,   // ー, repeats the last vowel
+  };
+
+  struct Syllable
+  {
+    std::array<char, 3> romaji;
+    uint8_t size;
+    Kind kind;
+
+    constexpr std::string_view view() const { return std::string_view(romaji.data(), size); }
+  };
+
+  constexpr Syllable syllable(std::string_view romaji, Kind kind)
+  {
+    Syllable result{};
+    for (size_t i = 0; i < romaji.size(); ++i)
+    {
+      result.romaji[i] = romaji[i];
+    }
+    result.size = static_cast<uint8_t>(romaji.size());
+    result.kind = romaji.empty() && kind == plain ? other : kind;
+    return result;
+  }
+
+  // U+3040..U+309F, katakana U+30A1..U+30F6 mirror it 0x60 higher
+  constexpr std::array<std::string_view, 96> HIRAGANA = {
+      "", "a", "a", "i", "i", "u", "u", "e", "e", "o", "o",
+      "ka", "ga", "ki", "gi", "ku", "gu", "ke", "ge", "ko", "go",
+      "sa", "za", "shi", "ji", "su", "zu", "se", "ze", "so", "zo",
+      "ta", "da", "chi", "ji", "", "tsu", "zu", "te", "de", "to", "do",
+      "na", "ni", "nu", "ne", "no",
+      "ha", "ba", "pa", "hi", "bi", "pi", "fu", "bu", "pu", "he", "be", "pe", "ho", "bo", "po",
+      "ma", "mi", "mu", "me", "mo",
+      "ya", "ya", "yu", "yu", "yo", "yo",
+      "ra", "ri", "ru", "re", "ro",
+      "wa", "wa", "wi", "we", "wo", "n", "vu", "ka", "ke",
+      "", "", "", "", "", "", "", "", ""};
+
+  constexpr Kind hiraganaKind(size_t index)
+  {
+    switch (0x3040 + index)
+    {
+    case U'ぁ': case U'ぃ': case U'ぅ': case U'ぇ': case U'ぉ': case U'ゎ':
+      return smallVowel;
+    case U'ゃ': case U'ゅ': case U'ょ':
+      return smallY;
+    case U'っ':
+      return sokuon;
+    default:
+      return plain;
+    }
+  }
+
+  // Indexed by code point - U+3040, which is where the three-byte UTF-8 form
+  // E3 81..83 xx puts every kana
+  constexpr std::array<Syllable, 192> buildKana()
+  {
+    std::array<Syllable, 192> table{};
+    for (size_t i = 0; i < HIRAGANA.size(); ++i)
+    {
+      table[i] = syllable(HIRAGANA[i], hiraganaKind(i));
+    }
+    for (char32_t c = U'ァ'; c <= U'ヶ'; ++c)
+    {
+      table[c - 0x3040] = table[c - 0x60 - 0x3040];
+    }
+    table[U'ヷ' - 0x3040] = syllable("va", plain);
+    table[U'ヸ' - 0x3040] = syllable("vi", plain);
+    table[U'ヹ' - 0x3040] = syllable("ve", plain);
+    table[U'ヺ' - 0x3040] = syllable("vo", plain);
+    table[U'ー' - 0x3040] = syllable("", longMark);
+    return table;
+  }
+
+  constexpr std::array<Syllable, 192> KANA = buildKana();
+
+  struct RomajiRule
+  {
+    std::string_view romaji;
+    std::string_view kana;
+  };
+
+  // Everything toRomaji can spell, plus Kunrei aliases
+  constexpr RomajiRule RULES[] = {
+      {"a", "あ"}, {"i", "い"}, {"u", "う"}, {"e", "え"}, {"o", "お"},
+      {"ka", "か"}, {"ki", "き"}, {"ku", "く"}, {"ke", "け"}, {"ko", "こ"}, {"kya", "きゃ"}, {"kyu", "きゅ"}, {"kyo", "きょ"},
+      {"ga", "が"}, {"gi", "ぎ"}, {"gu", "ぐ"}, {"ge", "げ"}, {"go", "ご"}, {"gya", "ぎゃ"}, {"gyu", "ぎゅ"}, {"gyo", "ぎょ"},
+      {"sa", "さ"}, {"shi", "し"}, {"su", "す"}, {"se", "せ"}, {"so", "そ"}, {"sha", "しゃ"}, {"shu", "しゅ"}, {"sho", "しょ"}, {"she", "しぇ"},
+      {"si", "し"}, {"sya", "しゃ"}, {"syu", "しゅ"}, {"syo", "しょ"},
+      {"za", "ざ"}, {"ji", "じ"}, {"zu", "ず"}, {"ze", "ぜ"}, {"zo", "ぞ"}, {"ja", "じゃ"}, {"ju", "じゅ"}, {"jo", "じょ"}, {"je", "じぇ"},
+      {"zi", "じ"}, {"jya", "じゃ"}, {"jyu", "じゅ"}, {"jyo", "じょ"}, {"zya", "じゃ"}, {"zyu", "じゅ"}, {"zyo", "じょ"},
+      {"ta", "た"}, {"chi", "ち"}, {"tsu", "つ"}, {"te", "て"}, {"to", "と"}, {"cha", "ちゃ"}, {"chu", "ちゅ"}, {"cho", "ちょ"}, {"che", "ちぇ"},
+      {"ti", "てぃ"}, {"tu", "とぅ"}, {"tyu", "てゅ"}, {"tsa", "つぁ"}, {"tsi", "つぃ"}, {"tse", "つぇ"}, {"tso", "つぉ"},
+      {"da", "だ"}, {"de", "で"}, {"do", "ど"}, {"di", "でぃ"}, {"du", "どぅ"}, {"dyu", "でゅ"},
+      {"na", "な"}, {"ni", "に"}, {"nu", "ぬ"}, {"ne", "ね"}, {"no", "の"}, {"nya", "にゃ"}, {"nyu", "にゅ"}, {"nyo", "にょ"}, {"n", "ん"},
+      {"ha", "は"}, {"hi", "ひ"}, {"fu", "ふ"}, {"he", "へ"}, {"ho", "ほ"}, {"hya", "ひゃ"}, {"hyu", "ひゅ"}, {"hyo", "ひょ"},
+      {"fa", "ふぁ"}, {"fi", "ふぃ"}, {"fe", "ふぇ"}, {"fo", "ふぉ"}, {"fyu", "ふゅ"}, {"hu", "ふ"},
+      {"ba", "ば"}, {"bi", "び"}, {"bu", "ぶ"}, {"be", "べ"}, {"bo", "ぼ"}, {"bya", "びゃ"}, {"byu", "びゅ"}, {"byo", "びょ"},
+      {"pa", "ぱ"}, {"pi", "ぴ"}, {"pu", "ぷ"}, {"pe", "ぺ"}, {"po", "ぽ"}, {"pya", "ぴゃ"}, {"pyu", "ぴゅ"}, {"pyo", "ぴょ"},
+      {"ma", "ま"}, {"mi", "み"}, {"mu", "む"}, {"me", "め"}, {"mo", "も"}, {"mya", "みゃ"}, {"myu", "みゅ"}, {"myo", "みょ"},
+      {"ya", "や"}, {"yu", "ゆ"}, {"yo", "よ"}, {"ye", "いぇ"},
+      {"ra", "ら"}, {"ri", "り"}, {"ru", "る"}, {"re", "れ"}, {"ro", "ろ"}, {"rya", "りゃ"}, {"ryu", "りゅ"}, {"ryo", "りょ"},
+      {"wa", "わ"}, {"wi", "うぃ"}, {"we", "うぇ"}, {"wo", "を"},
+      {"va", "ゔぁ"}, {"vi", "ゔぃ"}, {"vu", "ゔ"}, {"ve", "ゔぇ"}, {"vo", "ゔぉ"},
+  };
+
+  constexpr size_t DFA_STATES = 192;
+
+  // Trie over a-z, state 0 is the start and doubles as "no transition"
+  struct RomajiDfa
+  {
+    std::array<std::array<uint8_t, 26>, DFA_STATES> next{};
+    // RULES index + 1 of the spelling ending in the state, 0 if none
+    std::array<uint8_t, DFA_STATES> rule{};
+  };
+
+  constexpr RomajiDfa buildDfa()
+  {
+    RomajiDfa dfa;
+    size_t states = 1;
+    for (size_t i = 0; i < std::size(RULES); ++i)
+    {
+      size_t state = 0;
+      for (const char c : RULES[i].romaji)
+      {
+        uint8_t &next = dfa.next[state][c - 'a'];
+        if (!next)
+        {
+          // Fails constant evaluation when DFA_STATES is too small
+          next = states < DFA_STATES ? static_cast<uint8_t>(states++) : throw std::length_error("DFA_STATES");
+        }
+        state = next;
+      }
+      dfa.rule[state] = static_cast<uint8_t>(i + 1);
+    }
+    return dfa;
+  }
+
+  constexpr RomajiDfa DFA = buildDfa();
+  static_assert(std::size(RULES) < UINT8_MAX);
+
+  constexpr std::string_view SMALL_TSU = "っ";
+  constexpr std::string_view LONG_MARK = "ー";
+
+  char lower(char c)
+  {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+  }
+
+  // Letter index for the DFA, -1 for anything else
+  int letter(char c)
+  {
+    c = lower(c);
+    return c >= 'a' && c <= 'z' ? c - 'a' : -1;
+  }
+
+  bool isVowel(char c)
+  {
+    return c == 'a' || c == 'i' || c == 'u' || c == 'e' || c == 'o';
+  }
+
+  // Length of the ASCII prefix of [begin, end)
+  size_t asciiRun(const char *begin, const char *end)
+  {
+    const char *p = begin;
+#if defined(__SSE2__)
+    for (; end - p >= 16; p += 16)
+    {
+      const unsigned mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+      if (mask)
+      {
+        return p - begin + std::countr_zero(mask);
+      }
+    }
+#endif
+    while (p < end && static_cast<unsigned char>(*p) < 0x80)
+    {
+      ++p;
+    }
+    return p - begin;
+  }
+
+  const Syllable *kanaAt(const char *p, const char *end)
+  {
+    const auto *bytes = reinterpret_cast<const unsigned char *>(p);
+    if (end - p < 3 || bytes[0] != 0xE3 || bytes[1] < 0x81 || bytes[1] > 0x83 || (bytes[2] & 0xC0) != 0x80)
+    {
+      return nullptr;
+    }
+    const Syllable &kana = KANA[(bytes[1] - 0x81) * 64 + (bytes[2] & 0x3F)];
+    return kana.kind == other ? nullptr : &kana;
+  }
+
+  struct Mora
+  {
+    std::array<char, 4> romaji;
+    size_t size = 0;
+
+    void append(std::string_view text)
+    {
+      std::memcpy(romaji.data() + size, text.data(), text.size());
+      size += text.size();
+    }
+  };
+
+  // Spells kana and the small kana after it as one syllable if they form
+  // one: き+ゃ kya, し+ゃ sha, フ+ァ fa, テ+ィ ti, ウ+ィ wi, イ+ェ ye
+  bool fuse(const Syllable &kana, const Syllable &small, Mora &mora)
+  {
+    const std::string_view base = kana.view();
+    std::string_view tail = small.view();
+    if (base.size() < 2 || !isVowel(base.back()))
+    {
+      if (small.kind == smallVowel && tail.size() == 1 && (base == "u" || (base == "i" && tail == "e")))
+      {
+        mora.append(base == "u" ? "w" : "y");
+        mora.append(tail);
+        return true;
+      }
+      return false;
+    }
+    const std::string_view stem = base.substr(0, base.size() - 1);
+    if (small.kind == smallY && base.back() == 'i' && (stem == "sh" || stem == "ch" || stem == "j"))
+    {
+      tail.remove_prefix(1);
+    }
+    mora.append(stem);
+    mora.append(tail);
+    return true;
+  }
+
+  size_t sequenceLength(unsigned char lead, size_t available)
+  {
+    const size_t length = lead < 0xC0 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+    return std::min(length, available);
+  }
+}
+
+namespace Bot::Kana
+{
+  size_t toRomaji(std::string_view input, std::span<char> out)
+  {
+    if (out.size() < maxRomajiSize(input.size()))
+    {
+      throw std::length_error("Romaji buffer is too small");
+    }
+    const char *in = input.data();
+    const char *const end = in + input.size();
+    char *const begin = out.data();
+    char *o = begin;
+    bool doubled = false;
+    while (in < end)
+    {
+      if (const size_t ascii = asciiRun(in, end))
+      {
+        std::memcpy(o, in, ascii);
+        o += ascii;
+        in += ascii;
+        doubled = false;
+        continue;
+      }
+
+      const Syllable *kana = kanaAt(in, end);
+      if (!kana)
+      {
+        const size_t length = sequenceLength(*in, end - in);
+        std::memcpy(o, in, length);
+        o += length;
+        in += length;
+        doubled = false;
+        continue;
+      }
+      in += 3;
+
+      if (kana->kind == sokuon)
+      {
+        doubled = true;
+        continue;
+      }
+      if (kana->kind == longMark)
+      {
+        *o = o > begin && isVowel(o[-1]) ? o[-1] : '-';
+        ++o;
+        doubled = false;
+        continue;
+      }
+
+      Mora mora;
+      const Syllable *small = kanaAt(in, end);
+      if (kana->kind == plain && small && (small->kind == smallY || small->kind == smallVowel) && fuse(*kana, *small, mora))
+      {
+        in += 3;
+      }
+      else
+      {
+        mora.append(kana->view());
+      }
+      if (doubled && !isVowel(mora.romaji[0]) && mora.romaji[0] != 'n')
+      {
+        // っち is tchi, not cchi
+        *o++ = mora.romaji[0] == 'c' ? 't' : mora.romaji[0];
+      }
+      doubled = false;
+      std::memcpy(o, mora.romaji.data(), mora.size);
+      o += mora.size;
+    }
+    return o - begin;
+  }
+
+  size_t fromRomaji(std::string_view input, std::span<char> out)
+  {
+    if (out.size() < maxKanaSize(input.size()))
+    {
+      throw std::length_error("Kana buffer is too small");
+    }
+    const char *in = input.data();
+    const char *const end = in + input.size();
+    char *const begin = out.data();
+    char *o = begin;
+    auto emit = [&o](std::string_view kana)
+    {
+      std::memcpy(o, kana.data(), kana.size());
+      o += kana.size();
+    };
+
+    while (in < end)
+    {
+      const char c = lower(*in);
+      if (letter(c) < 0)
+      {
+        if (*in == '-')
+        {
+          emit(LONG_MARK);
+        }
+        else
+        {
+          *o++ = *in;
+        }
+        ++in;
+        continue;
+      }
+
+      // A doubled consonant, or the t of tch, is a small tsu
+      if (!isVowel(c) && c != 'n' && end - in >= 2 &&
+          (lower(in[1]) == c || (c == 't' && end - in >= 3 && lower(in[1]) == 'c' && lower(in[2]) == 'h')))
+      {
+        emit(SMALL_TSU);
+        ++in;
+        continue;
+      }
+
+      // Longest spelling that matches
+      uint8_t state = 0;
+      uint8_t rule = 0;
+      const char *matched = in;
+      for (const char *p = in; p < end; ++p)
+      {
+        const int next = letter(*p);
+        if (next < 0 || !(state = DFA.next[state][next]))
+        {
+          break;
+        }
+        if (DFA.rule[state])
+        {
+          rule = DFA.rule[state];
+          matched = p + 1;
+        }
+      }
+      if (!rule)
+      {
+        *o++ = *in++;
+        continue;
+      }
+      const RomajiRule &match = RULES[rule - 1];
+      emit(match.kana);
+      in = matched;
+
+      // n' and an nn that doesn't start the next syllable are one ん
+      if (match.romaji == "n" && in < end)
+      {
+        if (*in == '\'')
+        {
+          ++in;
+        }
+        else if (lower(*in) == 'n' && (end - in < 2 || !(isVowel(lower(in[1])) || lower(in[1]) == 'y')))
+        {
+          ++in;
+        }
+      }
+    }
+    return o - begin;
+  }
+
+  std::string_view toRomaji(std::string_view input, std::string &buffer)
+  {
+    buffer.resize(maxRomajiSize(input.size()));
+    buffer.resize(toRomaji(input, std::span<char>(buffer)));
+    return buffer;
+  }
+
+  std::string_view fromRomaji(std::string_view input, std::string &buffer)
+  {
+    buffer.resize(maxKanaSize(input.size()));
+    buffer.resize(fromRomaji(input, std::span<char>(buffer)));
+    return buffer;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Bot::Kana
+{
+  // Table-driven kana <-> romaji (Hepburn) transliteration. Both directions
+  // run over UTF-8 in one pass without allocating: kana is decoded straight
+  // from its three-byte form into a code point table, romaji is matched by a
+  // DFA built at compile time, and everything else is copied through as is.
+  //
+  // Every romaji spelling toRomaji produces reads back as kana with the same
+  // spelling, so answers can be compared on their romaji form whatever the
+  // user typed. The common Kunrei spellings (si, zi, hu, sya...) are read
+  // as their Hepburn syllable.
+
+  // Romaji is never longer than the kana it came from
+  constexpr size_t maxRomajiSize(size_t size) { return size; }
+  // One ASCII letter becomes at most one three-byte kana
+  constexpr size_t maxKanaSize(size_t size) { return 3 * size; }
+
+  // Hiragana and katakana to romaji, other text is kept. Writes into out,
+  // which must hold maxRomajiSize(input.size()) bytes, and returns the
+  // number of bytes written. Throws std::length_error if out is too small.
+  size_t toRomaji(std::string_view input, std::span<char> out);
+  // Romaji to hiragana, other text is kept. out must hold
+  // maxKanaSize(input.size()) bytes.
+  size_t fromRomaji(std::string_view input, std::span<char> out);
+
+  // Same, into a buffer the caller keeps between calls. The view is valid
+  // until the buffer is modified.
+  std::string_view toRomaji(std::string_view input, std::string &buffer);
+  std::string_view fromRomaji(std::string_view input, std::string &buffer);
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "updatedispatcher.hpp"
+#include "log.hpp"
+
+namespace Bot
+{
+  UpdateDispatcher::UpdateDispatcher(const TgBot::Bot &bot)
+      : handler_(bot.getEventHandler())
+  {
+  }
+
+  bool UpdateDispatcher::enqueue(TgBot::Update::Ptr update)
+  {
+    return queue_.push({std::move(update), Clock::now()});
+  }
+
+  void UpdateDispatcher::stop()
+  {
+    queue_.close();
+  }
+
+  void UpdateDispatcher::run()
+  {
+    Item item;
+    while (queue_.waitPop(item))
+    {
+      const uint64_t lagUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - item.queued).count();
+      dispatched_++;
+      totalLagUs_ += lagUs;
+      if (lagUs > maxLagUs_)
+      {
+        maxLagUs_ = lagUs;
+      }
+
+      try
+      {
+        handler_.handleUpdate(item.update);
+      }
+      catch (const std::exception &e)
+      {
+        LOG_EXCEPTION("Exception while dispatching an update", e);
+      }
+      item.update.reset();
+    }
+  }
+
+  UpdateDispatcher::Stats UpdateDispatcher::stats() const
+  {
+    Stats result;
+    result.queueDepth = queue_.size();
+    result.dispatched = dispatched_;
+    result.maxLagUs = maxLagUs_;
+    if (result.dispatched)
+    {
+      result.avgLagUs = totalLagUs_ / result.dispatched;
+    }
+    return result;
+  }
+}
\ No newline at end of file
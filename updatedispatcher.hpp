@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <tgbot/tgbot.h>
+#include "mpscqueue.hpp"
+
+namespace Bot
+{
+  // Hands updates from any number of ingestion threads to a single consumer
+  // that runs them through the bot event handlers in arrival order. The
+  // handlers only route into user sessions, so one consumer keeps up.
+  class UpdateDispatcher
+  {
+  public:
+    using Ptr = std::unique_ptr<UpdateDispatcher>;
+
+    struct Stats
+    {
+      size_t queueDepth = 0;
+      uint64_t dispatched = 0;
+      uint64_t avgLagUs = 0;
+      uint64_t maxLagUs = 0;
+    };
+
+    UpdateDispatcher(const TgBot::Bot &bot);
+    UpdateDispatcher(const UpdateDispatcher &) = delete;
+    UpdateDispatcher &operator=(const UpdateDispatcher &) = delete;
+
+    // False once stop() has been called, the update is then dropped
+    bool enqueue(TgBot::Update::Ptr update);
+    // Dispatches queued updates until stop() is called.
+    void run();
+    void stop();
+    Stats stats() const;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Item
+    {
+      TgBot::Update::Ptr update;
+      Clock::time_point queued;
+    };
+
+    const TgBot::EventHandler &handler_;
+    MpscQueue<Item> queue_;
+
+    std::atomic<uint64_t> dispatched_ = 0;
+    std::atomic<uint64_t> totalLagUs_ = 0;
+    std::atomic<uint64_t> maxLagUs_ = 0;
+  };
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "updatepoller.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  constexpr std::chrono::milliseconds POLL_ERROR_BACKOFF(1000);
+}
+
+namespace Bot
+{
+  UpdatePoller::UpdatePoller(TgBot::Bot &bot, UpdateDispatcher &dispatcher, int32_t timeout, int32_t limit)
+      : bot_(bot), dispatcher_(dispatcher), timeout_(timeout), limit_(std::clamp<int32_t>(limit, 1, MAX_BATCH))
+  {
+  }
+
+  UpdatePoller::~UpdatePoller()
+  {
+    stop();
+  }
+
+  void UpdatePoller::start()
+  {
+    thread_ = std::thread(&UpdatePoller::run, this);
+  }
+
+  void UpdatePoller::stop()
+  {
+    stopping_ = true;
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+
+  void UpdatePoller::run()
+  {
+    LOG_INFO("Long polling started: batch {}, timeout {}s\n", limit_, timeout_);
+    while (!stopping_)
+    {
+      std::vector<TgBot::Update::Ptr> updates;
+      const auto started = std::chrono::steady_clock::now();
+      try
+      {
+        updates = bot_.getApi().getUpdates(offset_, limit_, timeout_);
+      }
+      catch (const std::exception &e)
+      {
+        errors_++;
+        LOG_EXCEPTION("Exception while polling updates", e);
+        std::this_thread::sleep_for(POLL_ERROR_BACKOFF);
+        continue;
+      }
+      const uint64_t roundTripMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+
+      polls_++;
+      updates_ += updates.size();
+      totalRoundTripMs_ += roundTripMs;
+      maxRoundTripMs_ = std::max<uint64_t>(maxRoundTripMs_, roundTripMs);
+      maxBatch_ = std::max<uint64_t>(maxBatch_, updates.size());
+
+      for (auto &update : updates)
+      {
+        const auto updateId = update->updateId;
+        if (!dispatcher_.enqueue(std::move(update)))
+        {
+          // offset_ doesn't confirm it, Telegram delivers it again after a restart
+          LOG_INFO("Update {} dropped, the dispatcher has stopped\n", updateId);
+          stopping_ = true;
+          break;
+        }
+        offset_ = std::max(offset_, updateId + 1);
+      }
+    }
+    LOG_INFO("Long polling stopped\n");
+  }
+
+  UpdatePoller::Stats UpdatePoller::stats() const
+  {
+    Stats result;
+    result.polls = polls_;
+    result.errors = errors_;
+    result.updates = updates_;
+    result.maxRoundTripMs = maxRoundTripMs_;
+    result.maxBatch = maxBatch_;
+    if (result.polls)
+    {
+      result.avgRoundTripMs = totalRoundTripMs_ / result.polls;
+      result.avgBatch = result.updates / result.polls;
+    }
+    return result;
+  }
+}
\ No newline at end of file
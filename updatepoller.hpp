@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <tgbot/tgbot.h>
+#include "updatedispatcher.hpp"
+
+namespace Bot
+{
+  // Long-poll ingestion thread. Fetches updates in batches of up to `limit`
+  // and queues them on the dispatcher without waiting for any handler, so a
+  // slow handler never delays the next getUpdates round-trip.
+  class UpdatePoller
+  {
+  public:
+    using Ptr = std::unique_ptr<UpdatePoller>;
+
+    // Telegram caps getUpdates at 100 updates per call
+    static constexpr int32_t MAX_BATCH = 100;
+
+    struct Stats
+    {
+      uint64_t polls = 0;
+      uint64_t errors = 0;
+      uint64_t updates = 0;
+      uint64_t avgRoundTripMs = 0;
+      uint64_t maxRoundTripMs = 0;
+      uint64_t avgBatch = 0;
+      uint64_t maxBatch = 0;
+    };
+
+    UpdatePoller(TgBot::Bot &bot, UpdateDispatcher &dispatcher, int32_t timeout = 10, int32_t limit = MAX_BATCH);
+    ~UpdatePoller();
+    UpdatePoller(const UpdatePoller &) = delete;
+    UpdatePoller &operator=(const UpdatePoller &) = delete;
+
+    void start();
+    // Returns once the poll in flight, if any, completes.
+    void stop();
+    Stats stats() const;
+
+  private:
+    void run();
+
+    TgBot::Bot &bot_;
+    UpdateDispatcher &dispatcher_;
+    const int32_t timeout_;
+    const int32_t limit_;
+    int32_t offset_ = 0;
+    std::atomic<bool> stopping_ = false;
+    std::thread thread_;
+
+    std::atomic<uint64_t> polls_ = 0;
+    std::atomic<uint64_t> errors_ = 0;
+    std::atomic<uint64_t> updates_ = 0;
+    std::atomic<uint64_t> totalRoundTripMs_ = 0;
+    std::atomic<uint64_t> maxRoundTripMs_ = 0;
+    std::atomic<uint64_t> maxBatch_ = 0;
+  };
+}
\ No newline at end of file
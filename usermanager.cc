@@ -10,7 +10,7 @@ inline constexpr const char *const SQL_OPTIONS =
     "PRAGMA main.temp_store=MEMORY;";
 namespace Bot
 {
-  UserManager::UserManager(TgBot::Bot &bot, const std::string &dbFilePath)
+  UserManager::UserManager(TgBot::Bot &bot, const BotConfig &config, const std::string &dbFilePath)
       : bot_(bot)
   {
     try
@@ -24,39 +24,96 @@ namespace Bot
       db->exec("CREATE TABLE IF NOT EXISTS User (ID INTEGER PRIMARY KEY AUTOINCREMENT, UserID INTEGER, Difficulty INTEGER DEFAULT 0, JLPT INTEGER DEFAULT 0)");
       db->exec("CREATE TABLE IF NOT EXISTS Quiz (ID INTEGER PRIMARY KEY AUTOINCREMENT, KanaReadingCorrect INTEGER DEFAULT 0, KanaReadingTotal INTEGER DEFAULT 0, WordReadingCorrect INTEGER DEFAULT 0, WordReadingTotal INTEGER DEFAULT 0, WordMeaningCorrect INTEGER DEFAULT 0, WordMeaningTotal INTEGER DEFAULT 0, RandomCorrect INTEGER DEFAULT 0, RandomTotal INTEGER DEFAULT 0, UserID INTEGER, FOREIGN KEY(UserID) REFERENCES User(ID) ON DELETE CASCADE)");
       db->exec("CREATE TABLE IF NOT EXISTS Settings (UserID INTEGER, Difficulty INTEGER DEFAULT 0, JLPT INTEGER DEFAULT 0)");
+      statements_ = std::make_unique<StatementPool>(*db);
+      quizStats_ = std::make_unique<QuizStatsRecorder>(*db, *statements_, std::chrono::milliseconds(config.statsFlushMs), config.statsFlushEvents);
+
+      SQLite::Statement query(*db, "SELECT ID FROM User");
+      while (query.executeStep())
+      {
+        registered_.insert(query.getColumn(0).getInt64());
+      }
+      LOG_INFO("Loaded {} registered users\n", registered_.size());
     }
     catch (const SQLite::Exception &e)
     {
       LOG_EXCEPTION("SQlite exception", e);
     }
+    if (db)
+    {
+      createQuizIndex();
+    }
   }
 
-  void UserManager::createUserEntry(int64_t username)
+  void UserManager::createQuizIndex()
   {
+    // Databases from before the index may hold several Quiz rows per user;
+    // their scores are summed into the oldest row before it is made unique.
+    // Without the index the recorder's upserts fail and are retried.
     try
     {
-      SQLite::Statement query(*db, "INSERT INTO User (ID) VALUES (?)");
-      query.bind(1, username);
-      query.exec();
+      SQLite::Transaction transaction(*db);
+      db->exec("UPDATE Quiz SET "
+               "KanaReadingCorrect = (SELECT SUM(KanaReadingCorrect) FROM Quiz AS q WHERE q.UserID = Quiz.UserID), "
+               "KanaReadingTotal = (SELECT SUM(KanaReadingTotal) FROM Quiz AS q WHERE q.UserID = Quiz.UserID), "
+               "WordReadingCorrect = (SELECT SUM(WordReadingCorrect) FROM Quiz AS q WHERE q.UserID = Quiz.UserID), "
+               "WordReadingTotal = (SELECT SUM(WordReadingTotal) FROM Quiz AS q WHERE q.UserID = Quiz.UserID), "
+               "WordMeaningCorrect = (SELECT SUM(WordMeaningCorrect) FROM Quiz AS q WHERE q.UserID = Quiz.UserID), "
+               "WordMeaningTotal = (SELECT SUM(WordMeaningTotal) FROM Quiz AS q WHERE q.UserID = Quiz.UserID), "
+               "RandomCorrect = (SELECT SUM(RandomCorrect) FROM Quiz AS q WHERE q.UserID = Quiz.UserID), "
+               "RandomTotal = (SELECT SUM(RandomTotal) FROM Quiz AS q WHERE q.UserID = Quiz.UserID) "
+               "WHERE ID IN (SELECT MIN(ID) FROM Quiz WHERE UserID IS NOT NULL GROUP BY UserID HAVING COUNT(*) > 1)");
+      const int removed = db->exec("DELETE FROM Quiz WHERE UserID IS NOT NULL AND ID NOT IN "
+                                   "(SELECT MIN(ID) FROM Quiz WHERE UserID IS NOT NULL GROUP BY UserID)");
+      db->exec("CREATE UNIQUE INDEX IF NOT EXISTS QuizUserID ON Quiz (UserID)");
+      transaction.commit();
+      if (removed)
+      {
+        LOG_INFO("Merged {} duplicate quiz rows\n", removed);
+      }
     }
     catch (const SQLite::Exception &e)
     {
-      LOG_EXCEPTION("SQlite exception", e);
+      LOG_EXCEPTION("Failed to create the quiz user index", e);
     }
   }
 
-  bool UserManager::userExists(int64_t username)
+  void UserManager::createUserEntry(int64_t username)
   {
     try
     {
-      SQLite::Statement query(*db, "SELECT ID FROM User WHERE ID = ?");
-      query.bind(1, username);
-      return query.executeStep();
+      auto query = statements_->acquire("INSERT INTO User (ID) VALUES (?)");
+      query->bind(1, username);
+      query->exec();
+      registered_.insert(username);
     }
     catch (const SQLite::Exception &e)
     {
       LOG_EXCEPTION("SQlite exception", e);
     }
-    return false;
+  }
+
+  bool UserManager::userExists(int64_t username)
+  {
+    return registered_.contains(username);
+  }
+
+  void UserManager::recordQuizAnswer(int64_t username, QuizKind kind, bool correct)
+  {
+    // Quiz rows reference User, answers of unregistered users have nowhere to go
+    if (!quizStats_ || !registered_.contains(username))
+    {
+      return;
+    }
+    quizStats_->record(username, kind, correct);
+  }
+
+  QuizStatsRecorder::Stats UserManager::quizStats() const
+  {
+    return quizStats_ ? quizStats_->stats() : QuizStatsRecorder::Stats();
+  }
+
+  StatementPool::Stats UserManager::statementStats() const
+  {
+    return statements_ ? statements_->stats() : StatementPool::Stats();
   }
 }
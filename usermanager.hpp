@@ -1,6 +1,10 @@
 #pragma once
 #include <tgbot/tgbot.h>
 #include <SQLiteCpp/SQLiteCpp.h>
+#include "botconfig.hpp"
+#include "concurrentidset.hpp"
+#include "quizstats.hpp"
+#include "statementpool.hpp"
 
 namespace Bot
 {
@@ -9,16 +13,27 @@ namespace Bot
   public:
     using Ptr = std::unique_ptr<UserManager>;
 
-    UserManager(TgBot::Bot& bot, const std::string& dbFilePath = "bot_stats.db3");
+    UserManager(TgBot::Bot& bot, const BotConfig& config = BotConfig(), const std::string& dbFilePath = "bot_stats.db3");
     ~UserManager() = default;
     UserManager(const UserManager&) = delete;
     UserManager& operator=(const UserManager&) = delete;    
 
     void createUserEntry(int64_t username);
     bool userExists(int64_t username);
+    StatementPool::Stats statementStats() const;
+    size_t registeredUsers() const { return registered_.size(); }
+
+    void recordQuizAnswer(int64_t username, QuizKind kind, bool correct);
+    QuizStatsRecorder::Stats quizStats() const;
 
   private:
+    void createQuizIndex();
+
     std::unique_ptr<SQLite::Database> db;
+    StatementPool::Ptr statements_;
+    QuizStatsRecorder::Ptr quizStats_;
+    // Every registered ID, so the per-command check never touches the database
+    ConcurrentIdSet registered_;
     TgBot::Bot& bot_;
   };
 }
\ No newline at end of file
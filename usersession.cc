@@ -0,0 +1,119 @@
+#include "usersession.hpp"
+#include "log.hpp"
+
+namespace
+{
+  // Upper bound of tasks a session runs before yielding its worker to other users
+  constexpr size_t STRAND_BATCH = 16;
+}
+
+namespace Bot
+{
+  UserSession::UserSession(int64_t userID, ThreadPool &pool)
+      : userID_(userID), pool_(pool)
+  {
+  }
+
+  void UserSession::post(Task task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+      if (running_)
+      {
+        return;
+      }
+      running_ = true;
+    }
+    pool_.submit([self = shared_from_this()]()
+                 { self->drain(); });
+  }
+
+  bool UserSession::busy()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_ || !tasks_.empty();
+  }
+
+  void UserSession::drain()
+  {
+    for (size_t i = 0; i < STRAND_BATCH; ++i)
+    {
+      Task task;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty())
+        {
+          running_ = false;
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+
+      try
+      {
+        task();
+      }
+      catch (const std::exception &e)
+      {
+        LOG_EXCEPTION("Unhandled exception in user session", e);
+      }
+      catch (...)
+      {
+        LOG_INFO("Unknown exception in session of user {}\n", userID_);
+      }
+    }
+
+    pool_.submit([self = shared_from_this()]()
+                 { self->drain(); });
+  }
+
+  SessionManager::SessionManager(ThreadPool &pool, QuizStore &quizzes)
+      : pool_(pool), quizzes_(quizzes)
+  {
+  }
+
+  UserSession &SessionManager::get(int64_t userID)
+  {
+    Shard &shard = shards_[static_cast<uint64_t>(userID) % SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry &entry = shard.sessions[userID];
+    if (!entry.session)
+    {
+      entry.session = std::make_shared<UserSession>(userID, pool_);
+    }
+    entry.touched = Clock::now();
+    return *entry.session;
+  }
+
+  void SessionManager::evict(Clock::duration idle)
+  {
+    const Clock::time_point cutoff = Clock::now() - idle;
+    for (Shard &shard : shards_)
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      evicted_ += std::erase_if(shard.sessions, [this, cutoff](const auto &item)
+                                {
+                                  UserSession &session = *item.second.session;
+                                  if (item.second.touched >= cutoff || session.busy())
+                                  {
+                                    return false;
+                                  }
+                                  // No task owns the strand and get() waits for the shard lock
+                                  quizzes_.finish(session.quiz);
+                                  return true; });
+    }
+  }
+
+  size_t SessionManager::size() const
+  {
+    size_t total = 0;
+    for (const auto &shard : shards_)
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      total += shard.sessions.size();
+    }
+    return total;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <tgbot/tgbot.h>
+#include "quizstore.hpp"
+#include "threadpool.hpp"
+
+namespace Bot
+{
+  enum class BotCommand
+  {
+    none,
+    searchSingleWord,
+    searchExample,
+    explainInput,
+    gameKanaReading,
+    gameAudition,
+    gameMeaning,
+    gameReading,
+    gameNumerals,
+    gameVerbs,
+    stop,
+    outputPause,
+  };
+
+  // Cursor over a result list that is shown page by page. "One more" resumes it,
+  // "Stop" or the timeout drops it; nothing waits in between.
+  struct Pagination
+  {
+    // Shows the result at the given position of the list
+    using Renderer = std::function<void(size_t index)>;
+
+    size_t size = 0;
+    size_t cursor = 0;
+    Renderer render;
+    uint64_t generation = 0;
+
+    bool active() const { return cursor < size; }
+    void reset()
+    {
+      size = 0;
+      cursor = 0;
+      render = nullptr;
+      generation++;
+    }
+  };
+
+  // Per-user actor. Tasks posted to a session run one at a time and in order on
+  // the shared pool, so everything below the strand is only touched by the
+  // task that currently owns it. Different users run in parallel.
+  class UserSession : public std::enable_shared_from_this<UserSession>
+  {
+  public:
+    using Ptr = std::shared_ptr<UserSession>;
+    using Task = std::function<void()>;
+    using ReplyCallback = std::function<void(TgBot::PollAnswer::Ptr answer)>;
+
+    UserSession(int64_t userID, ThreadPool &pool);
+    UserSession(const UserSession &) = delete;
+    UserSession &operator=(const UserSession &) = delete;
+
+    void post(Task task);
+    int64_t userID() const { return userID_; }
+    // A task is queued or running
+    bool busy();
+
+    // Strand-owned state
+    BotCommand command = BotCommand::none;
+    // Kana and numerals games, state lives in the QuizStore
+    QuizStore::Handle quiz;
+    // Set while the questions come from "Random test", they also count towards its score
+    bool randomQuiz = false;
+    ReplyCallback quizReply;
+    Pagination pagination;
+
+    // Bumped outside the strand for every inline query, only the latest one is answered
+    std::atomic<uint64_t> inlineQuery = 0;
+
+  private:
+    void drain();
+
+    const int64_t userID_;
+    ThreadPool &pool_;
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+    bool running_ = false;
+  };
+
+  class SessionManager
+  {
+  public:
+    using Ptr = std::unique_ptr<SessionManager>;
+
+    SessionManager(ThreadPool &pool, QuizStore &quizzes);
+    SessionManager(const SessionManager &) = delete;
+    SessionManager &operator=(const SessionManager &) = delete;
+
+    // Creates the session on first use. Every call counts as activity, so
+    // the reference stays valid for at least the idle time passed to evict().
+    UserSession &get(int64_t userID);
+    size_t size() const;
+    uint64_t evicted() const { return evicted_; }
+    // Drops the sessions untouched for longer than idle that have no task
+    // queued or running, together with their command and pagination. Their
+    // quiz is finished, nothing could reach its slot any more.
+    void evict(std::chrono::steady_clock::duration idle);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t SHARDS = 32;
+
+    struct Entry
+    {
+      UserSession::Ptr session;
+      Clock::time_point touched;
+    };
+
+    struct Shard
+    {
+      mutable std::mutex mutex;
+      std::unordered_map<int64_t, Entry> sessions;
+    };
+
+    ThreadPool &pool_;
+    QuizStore &quizzes_;
+    std::array<Shard, SHARDS> shards_;
+    std::atomic<uint64_t> evicted_ = 0;
+  };
+}
\ No newline at end of file
@@ -1,21 +1,40 @@
+#include <cerrno>
 #include <csignal>
+#include <curl/curl.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
 
 #include <tgbot/tgbot.h>
 #include "log.hpp"
 #include "botcommander.hpp"
+#include "updatepoller.hpp"
+#include "webhookserver.hpp"
 #include "metrics/profiler.hpp"
 
-std::atomic<bool> sigintReceived(false);
+// Written by the signal handler, the main thread waits on it and shuts down
+int shutdownEvent = -1;
 
-void handleSignal(int s)
+void handleSignal(int)
 {
-  LOG_INFO("Got SIGINT, exiting\n");
-  sigintReceived = true;
-  Profiler::getInstance().dumpTextReport("metrics.txt");
+  // Nothing here may lock or allocate: the interrupted thread could hold any
+  // lock the shutdown needs
+  const uint64_t one = 1;
+  [[maybe_unused]] const ssize_t written = write(shutdownEvent, &one, sizeof(one));
+}
+
+void waitForShutdown()
+{
+  uint64_t signals = 0;
+  while (read(shutdownEvent, &signals, sizeof(signals)) < 0 && errno == EINTR)
+  {
+  }
 }
 
 int main()
 {
+  // Once, before any thread can be inside curl
+  curl_global_init(CURL_GLOBAL_ALL);
 #if defined(WAKABOT_TOKEN)
   LOG_DEBUG("WAKABOT_TOKEN is set: {}\n", WAKABOT_TOKEN);
   TgBot::Bot bot(WAKABOT_TOKEN);
@@ -33,7 +52,8 @@ int main()
   Log::get().configure(TraceType::file).set_level(TraceSeverity::debug);
   LOG_INFO("Bot {} started\n", bot.getApi().getMe()->username);
 
-  Bot::BotCommander::Ptr commander = std::make_unique<Bot::BotCommander>(bot);
+  const Bot::BotConfig config = Bot::BotConfig::fromEnvironment();
+  Bot::BotCommander::Ptr commander = std::make_unique<Bot::BotCommander>(bot, config);
 
   // Set commands
   std::vector<TgBot::BotCommand::Ptr> commands;
@@ -60,7 +80,7 @@ int main()
                                    { commander->parseCommand(message); });
 
   bot.getEvents().onNonCommandMessage([&commander](TgBot::Message::Ptr message)
-                                      { commander->parseUserInputAsync(message); });
+                                      { commander->parseUserInput(message); });
 
   bot.getEvents().onCallbackQuery([&commander](TgBot::CallbackQuery::Ptr query)
                                   { commander->parseCallback(query); });
@@ -74,20 +94,67 @@ int main()
   bot.getEvents().onEditedMessage([&commander](TgBot::Message::Ptr message)
                                   { commander->parseEditedMessage(message); });
 
+  shutdownEvent = eventfd(0, EFD_CLOEXEC);
   signal(SIGINT, handleSignal);
 
-  bot.getApi().deleteWebhook();
-  TgBot::TgLongPoll longPoll(bot);
-  int lastUpdateId = 0;
-  try
+  Bot::UpdateDispatcher dispatcher(bot);
+  Bot::UpdatePoller::Ptr poller;
+  Bot::WebhookServer::Ptr webhook;
+  if (config.webhook.enabled)
   {
-    while (!sigintReceived)
+    webhook = std::make_unique<Bot::WebhookServer>(dispatcher, config.webhook);
+    if (!webhook->start())
+    {
+      commander.reset();
+      curl_global_cleanup();
+      return 1;
+    }
+    // Without a URL the webhook is expected to be registered by hand, or
+    // updates are only replayed locally
+    if (!config.webhook.url.empty())
     {
-      longPoll.start();
+      bot.getApi().setWebhook(config.webhook.url, nullptr, static_cast<int32_t>(config.webhook.maxConnections), {}, "", false,
+                              config.webhook.secret);
+      LOG_INFO("Webhook registered at {}\n", config.webhook.url);
     }
   }
-  catch (TgBot::TgException &e)
+  else
   {
-    LOG_EXCEPTION("Runtime error", e);
+    bot.getApi().deleteWebhook();
+    poller = std::make_unique<Bot::UpdatePoller>(bot, dispatcher, static_cast<int32_t>(config.pollTimeout));
+    poller->start();
   }
+  std::thread dispatching(&Bot::UpdateDispatcher::run, &dispatcher);
+  waitForShutdown();
+
+  LOG_INFO("Got SIGINT, exiting\n");
+  if (webhook)
+  {
+    webhook->refuse();
+  }
+  dispatcher.stop();
+  dispatching.join();
+  if (poller)
+  {
+    LOG_INFO("Waiting for the last poll to return\n");
+    poller->stop();
+    const auto poll = poller->stats();
+    LOG_INFO("Polling: polls={} errors={} updates={}, round-trip avg={}ms max={}ms, batch avg={} max={}\n",
+             poll.polls, poll.errors, poll.updates, poll.avgRoundTripMs, poll.maxRoundTripMs, poll.avgBatch, poll.maxBatch);
+  }
+  if (webhook)
+  {
+    webhook->stop();
+    const auto served = webhook->stats();
+    LOG_INFO("Webhook: connections={} open={} requests={} updates={} rejected={}\n",
+             served.connections, served.openConnections, served.requests, served.updates, served.rejected);
+  }
+  const auto dispatch = dispatcher.stats();
+  LOG_INFO("Dispatch: queue={} dispatched={}, lag avg={}us max={}us\n",
+           dispatch.queueDepth, dispatch.dispatched, dispatch.avgLagUs, dispatch.maxLagUs);
+  Profiler::getInstance().dumpTextReport("metrics.txt");
+  commander->reportMetrics();
+  commander.reset();
+  close(shutdownEvent);
+  curl_global_cleanup();
 }
\ No newline at end of file
@@ -0,0 +1,524 @@
+#include "webhookserver.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+  // Request line and headers; Telegram sends well under 1KB of them
+  constexpr size_t MAX_HEADER_BYTES = 8192;
+  constexpr size_t READ_CHUNK = 16384;
+  constexpr int MAX_EVENTS = 64;
+  constexpr std::chrono::seconds SWEEP_INTERVAL(1);
+
+  std::string_view reason(int status)
+  {
+    switch (status)
+    {
+    case 200:
+      return "OK";
+    case 400:
+      return "Bad Request";
+    case 403:
+      return "Forbidden";
+    case 404:
+      return "Not Found";
+    case 405:
+      return "Method Not Allowed";
+    case 411:
+      return "Length Required";
+    case 413:
+      return "Content Too Large";
+    case 431:
+      return "Request Header Fields Too Large";
+    case 501:
+      return "Not Implemented";
+    case 503:
+      return "Service Unavailable";
+    default:
+      return "HTTP Version Not Supported";
+    }
+  }
+
+  bool equalsIgnoreCase(std::string_view a, std::string_view b)
+  {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+                                              { return (x | 0x20) == (y | 0x20); });
+  }
+
+  std::string_view trim(std::string_view text)
+  {
+    const size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string_view::npos)
+    {
+      return {};
+    }
+    return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+  }
+}
+
+namespace Bot
+{
+  struct WebhookServer::Request
+  {
+    std::string_view method;
+    std::string_view target;
+    std::string_view secret;
+    std::string_view body;
+    size_t size = 0; // bytes of the buffer the request takes
+    bool close = false;
+  };
+
+  WebhookServer::WebhookServer(UpdateDispatcher &dispatcher, const WebhookConfig &config)
+      : dispatcher_(dispatcher), config_(config)
+  {
+  }
+
+  WebhookServer::~WebhookServer()
+  {
+    stop();
+  }
+
+  bool WebhookServer::start()
+  {
+    sockaddr_storage address{};
+    socklen_t addressSize = 0;
+    auto *ipv4 = reinterpret_cast<sockaddr_in *>(&address);
+    auto *ipv6 = reinterpret_cast<sockaddr_in6 *>(&address);
+    if (inet_pton(AF_INET, config_.bind.c_str(), &ipv4->sin_addr) == 1)
+    {
+      ipv4->sin_family = AF_INET;
+      ipv4->sin_port = htons(static_cast<uint16_t>(config_.port));
+      addressSize = sizeof(sockaddr_in);
+    }
+    else if (inet_pton(AF_INET6, config_.bind.c_str(), &ipv6->sin6_addr) == 1)
+    {
+      ipv6->sin6_family = AF_INET6;
+      ipv6->sin6_port = htons(static_cast<uint16_t>(config_.port));
+      addressSize = sizeof(sockaddr_in6);
+    }
+    else
+    {
+      LOG_INFO("Webhook bind address {} is not an IP address\n", config_.bind);
+      return false;
+    }
+
+    const int reuse = 1;
+    listener_ = ::socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epoll_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeup_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event listenEvent{};
+    listenEvent.events = EPOLLIN;
+    listenEvent.data.fd = listener_;
+    epoll_event wakeupEvent{};
+    wakeupEvent.events = EPOLLIN;
+    wakeupEvent.data.fd = wakeup_;
+    if (listener_ < 0 || epoll_ < 0 || wakeup_ < 0 ||
+        ::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+        ::bind(listener_, reinterpret_cast<const sockaddr *>(&address), addressSize) < 0 ||
+        ::listen(listener_, SOMAXCONN) < 0 ||
+        ::epoll_ctl(epoll_, EPOLL_CTL_ADD, listener_, &listenEvent) < 0 ||
+        ::epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &wakeupEvent) < 0)
+    {
+      LOG_INFO("Webhook server can't listen on {}:{}: {}\n", config_.bind, config_.port, std::strerror(errno));
+      stop();
+      return false;
+    }
+    thread_ = std::thread(&WebhookServer::run, this);
+    return true;
+  }
+
+  void WebhookServer::stop()
+  {
+    stopping_ = true;
+    if (thread_.joinable())
+    {
+      const uint64_t one = 1;
+      [[maybe_unused]] const ssize_t written = ::write(wakeup_, &one, sizeof(one));
+      thread_.join();
+    }
+    for (int *fd : {&listener_, &epoll_, &wakeup_})
+    {
+      if (*fd >= 0)
+      {
+        ::close(*fd);
+        *fd = -1;
+      }
+    }
+  }
+
+  void WebhookServer::run()
+  {
+    LOG_INFO("Webhook server listening on {}:{}{}\n", config_.bind, config_.port, config_.path);
+    epoll_event events[MAX_EVENTS];
+    Clock::time_point swept = Clock::now();
+    while (!stopping_)
+    {
+      const int ready = ::epoll_wait(epoll_, events, MAX_EVENTS, std::chrono::milliseconds(SWEEP_INTERVAL).count());
+      if (ready < 0 && errno != EINTR)
+      {
+        LOG_INFO("Webhook server failed waiting for events: {}\n", std::strerror(errno));
+        break;
+      }
+      for (int i = 0; i < ready; ++i)
+      {
+        const int fd = events[i].data.fd;
+        if (fd == wakeup_)
+        {
+          continue;
+        }
+        if (fd == listener_)
+        {
+          accept();
+          continue;
+        }
+        auto it = connections_.find(fd);
+        if (it == connections_.end())
+        {
+          continue;
+        }
+        Connection &connection = it->second;
+        bool open = true;
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        {
+          open = read(fd, connection);
+          if (open)
+          {
+            serve(connection);
+          }
+        }
+        if (open && write(fd, connection))
+        {
+          watch(fd, connection);
+        }
+        else
+        {
+          close(fd);
+        }
+      }
+      if (Clock::now() - swept >= SWEEP_INTERVAL)
+      {
+        closeIdle();
+        swept = Clock::now();
+      }
+    }
+    while (!connections_.empty())
+    {
+      close(connections_.begin()->first);
+    }
+    LOG_INFO("Webhook server stopped\n");
+  }
+
+  void WebhookServer::accept()
+  {
+    for (;;)
+    {
+      const int fd = ::accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+          LOG_INFO("Webhook server failed to accept: {}\n", std::strerror(errno));
+        }
+        return;
+      }
+      if (connections_.size() >= config_.maxClients)
+      {
+        ::close(fd);
+        rejected_++;
+        continue;
+      }
+      // Responses are a single small segment, nothing to coalesce
+      const int noDelay = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+      epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.fd = fd;
+      if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) < 0)
+      {
+        ::close(fd);
+        continue;
+      }
+      connections_[fd].active = Clock::now();
+      accepted_++;
+      open_++;
+    }
+  }
+
+  bool WebhookServer::read(int fd, Connection &connection)
+  {
+    // No request is larger than this, a client sending more is cut off by parse()
+    const size_t limit = MAX_HEADER_BYTES + config_.maxBodyBytes + READ_CHUNK;
+    char buffer[READ_CHUNK];
+    while (connection.in.size() < limit)
+    {
+      const ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+      if (received > 0)
+      {
+        connection.in.append(buffer, static_cast<size_t>(received));
+        connection.active = Clock::now();
+        continue;
+      }
+      if (received < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      if (received == 0)
+      {
+        // The requests already buffered are still answered before closing
+        connection.eof = true;
+        return true;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    return true;
+  }
+
+  bool WebhookServer::write(int fd, Connection &connection)
+  {
+    size_t sent = 0;
+    while (sent < connection.out.size())
+    {
+      const ssize_t written = ::send(fd, connection.out.data() + sent, connection.out.size() - sent, MSG_NOSIGNAL);
+      if (written > 0)
+      {
+        sent += static_cast<size_t>(written);
+        continue;
+      }
+      if (written < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      {
+        break;
+      }
+      return false;
+    }
+    connection.out.erase(0, sent);
+    return !connection.closing || !connection.out.empty();
+  }
+
+  void WebhookServer::close(int fd)
+  {
+    ::close(fd);
+    connections_.erase(fd);
+    open_--;
+  }
+
+  // Reading stops while a response is pending: a client that doesn't read
+  // what it is sent gets no further requests answered either
+  void WebhookServer::watch(int fd, Connection &connection)
+  {
+    const bool writing = !connection.out.empty();
+    if (writing == connection.writing)
+    {
+      return;
+    }
+    epoll_event event{};
+    event.events = writing ? EPOLLOUT : EPOLLIN;
+    event.data.fd = fd;
+    ::epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &event);
+    connection.writing = writing;
+  }
+
+  void WebhookServer::closeIdle()
+  {
+    const Clock::time_point cutoff = Clock::now() - std::chrono::seconds(config_.idleSeconds);
+    std::vector<int> idle;
+    for (const auto &[fd, connection] : connections_)
+    {
+      if (connection.active < cutoff)
+      {
+        idle.push_back(fd);
+      }
+    }
+    for (const int fd : idle)
+    {
+      close(fd);
+    }
+  }
+
+  void WebhookServer::serve(Connection &connection)
+  {
+    size_t consumed = 0;
+    while (!connection.closing)
+    {
+      Request request;
+      const int status = parse(std::string_view(connection.in).substr(consumed), request);
+      if (!status)
+      {
+        break;
+      }
+      requests_++;
+      if (status != 200)
+      {
+        // Where the next request starts is unknown
+        respond(connection, status, true);
+        break;
+      }
+      respond(connection, handle(request), request.close);
+      consumed += request.size;
+    }
+    connection.in.erase(0, consumed);
+    connection.closing = connection.closing || connection.eof;
+  }
+
+  int WebhookServer::parse(std::string_view buffer, Request &request) const
+  {
+    const size_t headerEnd = buffer.find("\r\n\r\n");
+    if (headerEnd == std::string_view::npos || headerEnd > MAX_HEADER_BYTES)
+    {
+      return buffer.size() > MAX_HEADER_BYTES ? 431 : 0;
+    }
+    const std::string_view head = buffer.substr(0, headerEnd);
+    size_t lineEnd = head.find("\r\n");
+    const std::string_view requestLine = head.substr(0, lineEnd);
+    const size_t methodEnd = requestLine.find(' ');
+    const size_t targetEnd = requestLine.find(' ', methodEnd + 1);
+    if (methodEnd == std::string_view::npos || targetEnd == std::string_view::npos)
+    {
+      return 400;
+    }
+    request.method = requestLine.substr(0, methodEnd);
+    request.target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    const std::string_view version = requestLine.substr(targetEnd + 1);
+    if (version != "HTTP/1.1" && version != "HTTP/1.0")
+    {
+      return 505;
+    }
+    request.close = version == "HTTP/1.0";
+
+    size_t contentLength = std::string_view::npos;
+    while (lineEnd != std::string_view::npos)
+    {
+      const size_t lineBegin = lineEnd + 2;
+      lineEnd = head.find("\r\n", lineBegin);
+      const std::string_view line = head.substr(lineBegin, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - lineBegin);
+      const size_t colon = line.find(':');
+      if (colon == std::string_view::npos)
+      {
+        return 400;
+      }
+      const std::string_view name = line.substr(0, colon);
+      const std::string_view value = trim(line.substr(colon + 1));
+      if (equalsIgnoreCase(name, "Content-Length"))
+      {
+        size_t length = 0;
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), length);
+        if (error != std::errc() || end != value.data() + value.size() || (contentLength != std::string_view::npos && contentLength != length))
+        {
+          return 400;
+        }
+        contentLength = length;
+      }
+      else if (equalsIgnoreCase(name, "Transfer-Encoding"))
+      {
+        return 501;
+      }
+      else if (equalsIgnoreCase(name, "Connection"))
+      {
+        request.close = equalsIgnoreCase(value, "close") || (request.close && !equalsIgnoreCase(value, "keep-alive"));
+      }
+      else if (equalsIgnoreCase(name, "X-Telegram-Bot-Api-Secret-Token"))
+      {
+        request.secret = value;
+      }
+    }
+    if (contentLength == std::string_view::npos)
+    {
+      if (request.method == "POST")
+      {
+        return 411;
+      }
+      contentLength = 0;
+    }
+    if (contentLength > config_.maxBodyBytes)
+    {
+      return 413;
+    }
+    const size_t bodyBegin = headerEnd + 4;
+    if (buffer.size() - bodyBegin < contentLength)
+    {
+      return 0;
+    }
+    request.body = buffer.substr(bodyBegin, contentLength);
+    request.size = bodyBegin + contentLength;
+    return 200;
+  }
+
+  int WebhookServer::handle(const Request &request)
+  {
+    if (request.target != config_.path)
+    {
+      return 404;
+    }
+    if (request.method != "POST")
+    {
+      return 405;
+    }
+    if (!config_.secret.empty() && request.secret != config_.secret)
+    {
+      return 403;
+    }
+    if (refusing_)
+    {
+      return 503;
+    }
+    TgBot::Update::Ptr update;
+    try
+    {
+      TgBot::TgTypeParser parser;
+      update = parser.parseJsonAndGetUpdate(parser.parseJson(std::string(request.body)));
+    }
+    catch (const std::exception &e)
+    {
+      LOG_EXCEPTION("Malformed webhook update", e);
+      return 400;
+    }
+    // Stopping may have closed the queue since refusing_ was checked
+    if (!dispatcher_.enqueue(std::move(update)))
+    {
+      return 503;
+    }
+    updates_++;
+    return 200;
+  }
+
+  void WebhookServer::respond(Connection &connection, int status, bool close)
+  {
+    if (status != 200)
+    {
+      rejected_++;
+    }
+    connection.out += std::format("HTTP/1.1 {} {}\r\nContent-Length: 0\r\n{}\r\n", status, reason(status),
+                                  close ? "Connection: close\r\n" : "");
+    connection.closing = close;
+  }
+
+  WebhookServer::Stats WebhookServer::stats() const
+  {
+    Stats result;
+    result.connections = accepted_;
+    result.openConnections = open_;
+    result.requests = requests_;
+    result.updates = updates_;
+    result.rejected = rejected_;
+    return result;
+  }
+}
\ No newline at end of file
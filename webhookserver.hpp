@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include "botconfig.hpp"
+#include "updatedispatcher.hpp"
+
+namespace Bot
+{
+  // Webhook ingestion, the push counterpart of UpdatePoller: a plain HTTP/1.1
+  // server on one epoll thread that takes the update POSTs Telegram sends
+  // and queues them on the dispatcher before answering. Connections are kept
+  // alive and requests may be pipelined; headers and bodies are bounded and
+  // anything else (chunked bodies, other methods, other paths) is refused
+  // with a status. There is no TLS: it listens behind a reverse proxy that
+  // terminates HTTPS, or on localhost for replaying recorded updates.
+  class WebhookServer
+  {
+  public:
+    using Ptr = std::unique_ptr<WebhookServer>;
+
+    struct Stats
+    {
+      uint64_t connections = 0; // accepted since start
+      uint64_t openConnections = 0;
+      uint64_t requests = 0;
+      uint64_t updates = 0;
+      uint64_t rejected = 0; // answered with an error status
+    };
+
+    WebhookServer(UpdateDispatcher &dispatcher, const WebhookConfig &config);
+    ~WebhookServer();
+    WebhookServer(const WebhookServer &) = delete;
+    WebhookServer &operator=(const WebhookServer &) = delete;
+
+    // Binds and starts serving. Returns false if the address can't be bound.
+    bool start();
+    // Answers further updates with 503, which Telegram retries later, so
+    // nothing is acknowledged once the dispatcher stopped taking updates.
+    void refuse() { refusing_ = true; }
+    // Returns once the server thread has closed every connection.
+    void stop();
+    Stats stats() const;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection
+    {
+      std::string in;
+      std::string out;
+      Clock::time_point active;
+      bool closing = false; // close once out is flushed
+      bool eof = false;     // the peer has finished sending
+      bool writing = false; // waiting for EPOLLOUT
+    };
+
+    struct Request;
+
+    void run();
+    void accept();
+    // Both return false once the connection has to close
+    bool read(int fd, Connection &connection);
+    bool write(int fd, Connection &connection);
+    void close(int fd);
+    // Answers every complete request in the buffer
+    void serve(Connection &connection);
+    // 0 while the request is incomplete, otherwise its status
+    int parse(std::string_view buffer, Request &request) const;
+    int handle(const Request &request);
+    void respond(Connection &connection, int status, bool close);
+    void watch(int fd, Connection &connection);
+    void closeIdle();
+
+    UpdateDispatcher &dispatcher_;
+    const WebhookConfig config_;
+    int listener_ = -1;
+    int epoll_ = -1;
+    int wakeup_ = -1;
+    std::atomic<bool> stopping_ = false;
+    std::atomic<bool> refusing_ = false;
+    std::thread thread_;
+    std::unordered_map<int, Connection> connections_;
+
+    std::atomic<uint64_t> accepted_ = 0;
+    std::atomic<uint64_t> open_ = 0;
+    std::atomic<uint64_t> requests_ = 0;
+    std::atomic<uint64_t> updates_ = 0;
+    std::atomic<uint64_t> rejected_ = 0;
+  };
+}
\ No newline at end of file